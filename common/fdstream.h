@@ -0,0 +1,122 @@
+#pragma once
+
+// Large buffer I/O straight on file descriptors with read/write, 1 MiB at a time, shared by the tools
+// (add this directory to the include path). The name "-" stands for stdin/stdout, so the tools can be
+// chained in pipelines.
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#ifdef _WIN32
+inline int fd_open(const char* name, bool out) {
+    return out ? _open(name, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+               : _open(name, _O_RDONLY | _O_BINARY);
+}
+inline long long fd_read(int fd, char* p, size_t n) { return _read(fd, p, static_cast<unsigned>(n)); }
+inline long long fd_write(int fd, const char* p, size_t n) { return _write(fd, p, static_cast<unsigned>(n)); }
+inline void fd_close(int fd) { _close(fd); }
+#else
+inline int fd_open(const char* name, bool out) {
+    return out ? open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644) : open(name, O_RDONLY);
+}
+inline long long fd_read(int fd, char* p, size_t n) { return read(fd, p, n); }
+inline long long fd_write(int fd, const char* p, size_t n) { return write(fd, p, n); }
+inline void fd_close(int fd) { close(fd); }
+#endif
+
+class fdbuf : public std::streambuf {
+    int fd_ = -1;
+    bool owned_ = false;
+    std::vector<char> buf_;
+
+protected:
+    int_type underflow() override {
+        auto n = fd_read(fd_, buf_.data(), buf_.size());
+        if (n <= 0) {
+            return traits_type::eof();
+        }
+        setg(buf_.data(), buf_.data(), buf_.data() + n);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type overflow(int_type c) override {
+        if (sync() == -1) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        const char* p = pbase();
+        while (p < pptr()) {
+            auto n = fd_write(fd_, p, pptr() - p);
+            if (n <= 0) {
+                return -1;
+            }
+            p += n;
+        }
+        setp(buf_.data(), buf_.data() + buf_.size());
+        return 0;
+    }
+
+public:
+    fdbuf(const std::string& name, bool out) : buf_(1 << 20) {
+        if (name == "-") {
+            fd_ = out ? 1 : 0;
+#ifdef _WIN32
+            _setmode(fd_, _O_BINARY);
+#endif
+        }
+        else {
+            fd_ = fd_open(name.c_str(), out);
+            owned_ = true;
+        }
+        if (out) {
+            setp(buf_.data(), buf_.data() + buf_.size());
+        }
+    }
+    ~fdbuf() {
+        if (pbase() != nullptr) {
+            sync();
+        }
+        if (owned_ && fd_ >= 0) {
+            fd_close(fd_);
+        }
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+};
+
+struct fdistream : std::istream {
+    fdbuf buf_;
+    fdistream(const std::string& name) : std::istream(nullptr), buf_(name, false) {
+        rdbuf(&buf_);
+        if (!buf_.is_open()) {
+            setstate(std::ios::failbit);
+        }
+    }
+};
+
+struct fdostream : std::ostream {
+    fdbuf buf_;
+    fdostream(const std::string& name) : std::ostream(nullptr), buf_(name, true) {
+        rdbuf(&buf_);
+        if (!buf_.is_open()) {
+            setstate(std::ios::failbit);
+        }
+    }
+};
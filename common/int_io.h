@@ -0,0 +1,111 @@
+#pragma once
+
+// Text integer I/O shared by the tools (add this directory to the include path): int_reader parses
+// and int_writer formats base 10 integers, both in 1 MiB blocks.
+#include <charconv>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Fast text integer parser: base 10 integers separated by whitespace, read 1 MiB at a time straight
+// from the stream buffer and converted with std::from_chars (no locale, no sentry for each number).
+// Like operator>>, it stops at the first token that is not a number.
+class int_reader {
+    std::streambuf* sb_;
+    std::vector<char> buf_;
+    size_t pos_ = 0, end_ = 0;
+    bool eof_ = false;
+
+    static bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    // Move the unparsed tail to the front and append more input after it
+    bool fill() {
+        if (eof_) {
+            return false;
+        }
+        std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+        end_ -= pos_;
+        pos_ = 0;
+        auto n = sb_->sgetn(buf_.data() + end_, static_cast<std::streamsize>(buf_.size() - end_));
+        if (n <= 0) {
+            eof_ = true;
+            return false;
+        }
+        end_ += static_cast<size_t>(n);
+        return true;
+    }
+
+public:
+    int_reader(std::istream& is) : sb_(is.rdbuf()), buf_(1 << 20) {}
+
+    template<typename T>
+    bool operator()(T& value) {
+        while (true) {
+            while (pos_ < end_ && is_space(buf_[pos_])) {
+                ++pos_;
+            }
+            if (pos_ < end_) {
+                break;
+            }
+            if (!fill()) {
+                return false;
+            }
+        }
+        // The whole token must be in the buffer
+        size_t last = pos_;
+        while (true) {
+            while (last < end_ && !is_space(buf_[last])) {
+                ++last;
+            }
+            if (last < end_ || eof_) {
+                break;
+            }
+            size_t len = last - pos_;
+            fill();
+            last = pos_ + len;
+        }
+        const char* first = buf_.data() + pos_;
+        if (*first == '+') {
+            ++first;
+        }
+        auto [ptr, ec] = std::from_chars(first, buf_.data() + last, value);
+        if (ec != std::errc() || ptr == first) {
+            return false;
+        }
+        pos_ = ptr - buf_.data();
+        return true;
+    }
+};
+
+// Fast integer formatter: std::to_chars into a 1 MiB buffer, handed to the stream in big writes
+// (no locale, no sentry and no flush for each number)
+class int_writer {
+    std::ostream& os_;
+    std::vector<char> buf_;
+    size_t n_ = 0;
+
+public:
+    int_writer(std::ostream& os) : os_(os), buf_(1 << 20) {}
+    ~int_writer() {
+        flush();
+    }
+
+    template<typename T>
+    void operator()(T value, std::string_view sep = "") {
+        if (buf_.size() - n_ < 24 + sep.size()) {
+            flush();
+        }
+        char* ptr = std::to_chars(buf_.data() + n_, buf_.data() + buf_.size(), value).ptr;
+        std::memcpy(ptr, sep.data(), sep.size());
+        n_ = ptr + sep.size() - buf_.data();
+    }
+
+    void flush() {
+        os_.write(buf_.data(), n_);
+        n_ = 0;
+    }
+};
@@ -2,6 +2,17 @@
 #include <fstream>
 #include <bitset>
 #include <string>
+#include <string_view>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <vector>
+#include <random>
+#include <sstream>
+#include "fdstream.h"
+#include "int_io.h"
 
 /*Write a command line program in C++ with this syntax:
     elias [c|d] <filein> <fileout>
@@ -21,117 +32,530 @@ When the “d” option is specified, the data is decoded from binary to text. T
 file, with the name passed as the third parameter, with the same numbers saved in decimal text format,
 each followed by a new line.*/
 
+/*Other codes, selected with a trailing option (the same one must be given to "d"):
+    elias [c|d] <filein> <fileout> [-m gamma|delta|rice|expgolomb] [-k <order>]
+
+gamma       the default, as above
+delta       Elias delta: bit_width(x) in gamma, then x without its leading 1
+rice        Golomb-Rice of x - 1 in blocks of rice_block values, each block starts with its own parameter
+            (6 bit) chosen to minimise the block size
+expgolomb   Exp-Golomb of order k (-k, default 0) of x - 1
+All of them pad the last byte with 0. The codes start after a small header, so that "d" can refuse a
+file written with other options instead of decoding garbage:
+    MagicNumber     5 byte      "ELIAS"
+    Code            8 bit       0 gamma, 1 delta, 2 rice, 3 expgolomb
+    Order           8 bit       k of expgolomb, 0 for the others
+
+    elias t
+runs the round-trip self test of all the codes.*/
+
 #define DEBUG false
 
-std::ostream& write_byte(std::ostream& os, std::bitset<8>& buffer)
+// Word-level bit writer: the bits are packed MSB first in a 64 bit buffer and written 8 bytes at a time
+class bitwriter {
+    std::ostream& os_;
+    uint64_t buffer_ = 0;   // pending bits, the oldest one in the MSB
+    size_t n_ = 0;          // number of pending bits, always < 64
+
+    void write_word(uint64_t w, size_t bytes = 8) {
+        if constexpr (std::endian::native == std::endian::little) {
+            w = std::byteswap(w);
+        }
+        os_.write(reinterpret_cast<const char*>(&w), bytes);
+    }
+
+public:
+    bitwriter(std::ostream& os) : os_(os) {}
+    ~bitwriter() {
+        flush();
+    }
+
+    // Write the n (<= 64) least significant bits of u from MSB to LSB
+    void operator()(uint64_t u, size_t n) {
+        if (n == 0) {
+            return;
+        }
+        u &= ~uint64_t(0) >> (64 - n);
+        size_t room = 64 - n_;
+        if (n < room) {
+            buffer_ |= u << (room - n);
+            n_ += n;
+            return;
+        }
+        write_word(buffer_ | (u >> (n - room)));
+        n_ = n - room;
+        buffer_ = (n_ == 0) ? 0 : u << (64 - n_);
+    }
+
+    // Pad the last byte with 0
+    void flush() {
+        write_word(buffer_, (n_ + 7) / 8);
+        buffer_ = 0;
+        n_ = 0;
+    }
+};
+
+// 0, -1, 1, -2, 2, ... -> 1, 2, 3, 4, 5, ... (zigzag + 1, computed on 64 bit: INT32_MIN maps to 2^32)
+inline uint64_t elias_map(int32_t number)
 {
-    return os.write(reinterpret_cast<const char*>(&buffer), 1);
+    int64_t n = number;
+    return ((static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63)) + 1;
 }
 
-std::bitset<8> read_byte(std::ifstream& is)
+// Elias gamma: bit_width(x) - 1 zeros followed by x itself, that is x written on 2 * bit_width(x) - 1 bits
+inline void gamma_encode(bitwriter& bw, uint64_t x)
 {
-    unsigned char byte;
-    is.read(reinterpret_cast<char*>(&byte), 1);
-    return std::bitset<8>(byte);
+    size_t len = std::bit_width(x);
+    if (len > 32) {     // only 2^32, the code is 65 bits long
+        bw(0, len - 1);
+        bw(x, len);
+        return;
+    }
+    bw(x, 2 * len - 1);
+}
+
+// Elias delta: the length of x in gamma, then x without its leading 1
+inline void delta_encode(bitwriter& bw, uint64_t x)
+{
+    size_t len = std::bit_width(x);
+    gamma_encode(bw, len);
+    bw(x, len - 1);
+}
+
+// Exp-Golomb of order k: v + 2^k written like a gamma code, but with k zeros less
+inline void expgolomb_encode(bitwriter& bw, uint64_t v, size_t k)
+{
+    uint64_t y = v + (uint64_t(1) << k);
+    size_t len = std::bit_width(y);
+    size_t zeros = len - 1 - k;
+    if (zeros + len > 64) {
+        bw(0, zeros);
+        bw(y, len);
+        return;
+    }
+    bw(y, zeros + len);
+}
+
+// Golomb-Rice with parameter 2^k: v >> k in unary (that many zeros and a 1), then the k low bits.
+// A quotient of rice_escape or more is an escape followed by v on 32 bits, so an outlier can't explode.
+constexpr size_t rice_escape = 32;
+constexpr size_t rice_block = 128;
+
+inline size_t rice_cost(uint64_t v, size_t k)
+{
+    uint64_t q = v >> k;
+    return q < rice_escape ? q + 1 + k : rice_escape + 1 + 32;
+}
+
+inline void rice_encode(bitwriter& bw, uint64_t v, size_t k)
+{
+    uint64_t q = v >> k;
+    if (q >= rice_escape) {
+        bw(1, rice_escape + 1);
+        bw(v, 32);
+        return;
+    }
+    bw(1, q + 1);
+    bw(v, k);
+}
+
+// The block size as a function of k falls and then rises, so stop at the first k that makes it worse
+inline void rice_encode_block(bitwriter& bw, const std::vector<uint64_t>& block)
+{
+    size_t best_k = 0;
+    size_t best = SIZE_MAX;
+    for (size_t k = 0; k <= 32; ++k) {
+        size_t cost = 0;
+        for (const auto& v : block) {
+            cost += rice_cost(v, k);
+        }
+        if (cost >= best) {
+            break;
+        }
+        best = cost;
+        best_k = k;
+    }
+    bw(best_k, 6);
+    for (const auto& v : block) {
+        rice_encode(bw, v, best_k);
+    }
+}
+
+enum class elias_code { gamma, delta, rice, expgolomb };
+
+// Word-level bit reader: a 64 bit window holds the next bits MSB first, refilled a byte at a time
+// from a 64 KiB block of input
+class bitreader {
+    std::istream& is_;
+    std::vector<uint8_t> buf_;
+    size_t pos_ = 0, end_ = 0;
+    uint64_t window_ = 0;   // next bits, the oldest one in the MSB, the rest is 0
+    size_t n_ = 0;          // number of valid bits in window_
+
+    // Top up the window to more than 56 bits, unless the input is over
+    void refill() {
+        while (n_ <= 56) {
+            if (pos_ == end_) {
+                is_.read(reinterpret_cast<char*>(buf_.data()), buf_.size());
+                end_ = static_cast<size_t>(is_.gcount());
+                pos_ = 0;
+                if (end_ == 0) {
+                    return;
+                }
+            }
+            window_ |= static_cast<uint64_t>(buf_[pos_++]) << (56 - n_);
+            n_ += 8;
+        }
+    }
+
+    void skip(size_t n) {
+        window_ = (n < 64) ? window_ << n : 0;
+        n_ -= n;
+    }
+
+public:
+    bitreader(std::istream& is) : is_(is), buf_(1 << 16) {}
+
+    // Decode one Elias gamma code into x. Returns false at the end of the stream, when only
+    // the 0 padding (or a truncated code) is left.
+    bool gamma(uint64_t& x) {
+        refill();
+        size_t z = std::countl_zero(window_);
+        if (2 * z + 1 <= n_) {  // the whole code is in the window: one shift, one skip
+            size_t len = 2 * z + 1;
+            x = window_ >> (64 - len);
+            skip(len);
+            return true;
+        }
+
+        // Codes longer than the window (more than 28 zeros) or end of the stream
+        uint64_t low;
+        if (!zeros(z) || z > 32 || !read(low, z)) {  // no int32 needs more than a 65 bit code
+            return false;
+        }
+        x = (uint64_t(1) << z) | low;
+        return true;
+    }
+
+    bool delta(uint64_t& x) {
+        uint64_t len, low;
+        if (!gamma(len) || len > 33 || !read(low, len - 1)) {
+            return false;
+        }
+        x = (uint64_t(1) << (len - 1)) | low;
+        return true;
+    }
+
+    bool expgolomb(uint64_t& v, size_t k) {
+        size_t z;
+        uint64_t low;
+        if (!zeros(z) || z + k > 33 || !read(low, z + k)) {
+            return false;
+        }
+        v = ((uint64_t(1) << (z + k)) | low) - (uint64_t(1) << k);
+        return true;
+    }
+
+    bool rice(uint64_t& v, size_t k) {
+        size_t q;
+        uint64_t low;
+        if (!zeros(q) || q > rice_escape) {
+            return false;
+        }
+        if (q == rice_escape) {
+            return read(v, 32);
+        }
+        if (!read(low, k)) {
+            return false;
+        }
+        v = (uint64_t(q) << k) | low;
+        return true;
+    }
+
+    // Count the 0 bits before the next 1 and consume both
+    bool zeros(size_t& z) {
+        z = 0;
+        while (true) {
+            refill();
+            if (n_ == 0) {
+                return false;
+            }
+            if (window_ != 0) {
+                break;
+            }
+            z += n_;
+            skip(n_);
+        }
+        size_t c = std::countl_zero(window_);
+        z += c;
+        skip(c + 1);
+        return true;
+    }
+
+    // Read n (<= 64) bits into u from MSB to LSB
+    bool read(uint64_t& u, size_t n) {
+        u = 0;
+        while (n > 0) {
+            refill();
+            size_t k = std::min({ n, n_, size_t(56) });
+            if (k == 0) {
+                return false;
+            }
+            u = (u << k) | (window_ >> (64 - k));
+            skip(k);
+            n -= k;
+        }
+        return true;
+    }
+};
+
+// 1, 2, 3, 4, 5, ... -> 0, -1, 1, -2, 2, ...
+inline int32_t elias_unmap(uint64_t elias)
+{
+    uint64_t z = elias - 1;
+    return static_cast<int32_t>(static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1));
+}
+
+// Map and encode one value at a time with the selected code. Rice values are collected in blocks
+// of rice_block, the last (partial) one is written on destruction, before the bitwriter flushes.
+class elias_encoder {
+    bitwriter& bw_;
+    elias_code mode_;
+    size_t order_;
+    std::vector<uint64_t> block_;
+
+public:
+    elias_encoder(bitwriter& bw, elias_code mode, size_t order) : bw_(bw), mode_(mode), order_(order) {}
+    ~elias_encoder() {
+        if (!block_.empty()) {
+            rice_encode_block(bw_, block_);
+        }
+    }
+
+    void operator()(int32_t number) {
+        uint64_t elias = elias_map(number);
+        if (DEBUG) {std::cerr << "elias representation of " << number << " is " << std::bitset<65>(elias).to_string().substr(65 - 2 * std::bit_width(elias) + 1) << std::endl;}
+
+        switch (mode_) {
+        case elias_code::gamma: gamma_encode(bw_, elias); break;
+        case elias_code::delta: delta_encode(bw_, elias); break;
+        case elias_code::expgolomb: expgolomb_encode(bw_, elias - 1, order_); break;
+        case elias_code::rice:
+            block_.push_back(elias - 1);
+            if (block_.size() == rice_block) {
+                rice_encode_block(bw_, block_);
+                block_.clear();
+            }
+            break;
+        }
+    }
+};
+
+// Decode and unmap one value at a time. Returns false at the end of the stream.
+class elias_decoder {
+    bitreader& br_;
+    elias_code mode_;
+    size_t order_;
+    uint64_t rice_k_ = 0;
+    size_t rice_left_ = 0;  // values left in the current Rice block
+
+public:
+    elias_decoder(bitreader& br, elias_code mode, size_t order) : br_(br), mode_(mode), order_(order) {}
+
+    bool operator()(int32_t& number) {
+        uint64_t code;
+        bool ok = false;
+        switch (mode_) {
+        case elias_code::gamma: ok = br_.gamma(code); break;
+        case elias_code::delta: ok = br_.delta(code); break;
+        case elias_code::expgolomb: ok = br_.expgolomb(code, order_); ++code; break;
+        case elias_code::rice:
+            if (rice_left_ == 0) {
+                if (!br_.read(rice_k_, 6) || rice_k_ > 32) {
+                    return false;
+                }
+                rice_left_ = rice_block;
+            }
+            ok = br_.rice(code, rice_k_);
+            ++code;
+            --rice_left_;
+            break;
+        }
+        if (!ok) {
+            return false;
+        }
+        number = elias_unmap(code);
+        if (DEBUG) {std::cerr << "value -> " << number << std::endl;}
+        return true;
+    }
+};
+
+// Round trip through every code: the edge values (0, +-1, INT32_MIN/MAX, the powers of two and their
+// neighbours) and a seeded random sweep. Prints the first mismatch of each code and returns false.
+bool self_test()
+{
+    std::vector<int32_t> values = { 0, 1, -1, 8, -8, INT32_MIN, INT32_MIN + 1, INT32_MAX, INT32_MAX - 1 };
+    for (int b = 0; b < 31; ++b) {
+        int32_t p = int32_t(1) << b;
+        for (int32_t v : { p - 1, p, p + 1 }) {
+            values.push_back(v);
+            values.push_back(-v);
+        }
+    }
+    std::mt19937 rng(12345);
+    for (int i = 0; i < 100000; ++i) {
+        values.push_back(static_cast<int32_t>(rng()));
+    }
+
+    struct test { const char* name; elias_code mode; size_t order; };
+    const test tests[] = {
+        { "gamma", elias_code::gamma, 0 }, { "delta", elias_code::delta, 0 }, { "rice", elias_code::rice, 0 },
+        { "expgolomb -k 0", elias_code::expgolomb, 0 }, { "expgolomb -k 5", elias_code::expgolomb, 5 },
+        { "expgolomb -k 16", elias_code::expgolomb, 16 },
+    };
+    bool passed = true;
+    for (const auto& t : tests) {
+        std::stringstream ss;
+        {
+            bitwriter bw(ss);
+            elias_encoder encoder(bw, t.mode, t.order);
+            for (const auto& v : values) {
+                encoder(v);
+            }
+        }
+        bitreader br(ss);
+        elias_decoder decoder(br, t.mode, t.order);
+        size_t i = 0;
+        int32_t number;
+        while (decoder(number) && i < values.size() && number == values[i]) {
+            ++i;
+        }
+        if (i != values.size() || decoder(number)) {
+            std::println(std::cerr, "{}: mismatch at value {} of {}", t.name, i, values.size());
+            passed = false;
+        }
+        else {
+            std::println("{}: {} values, {} bytes, ok", t.name, values.size(), ss.str().size());
+        }
+    }
+    return passed;
+}
+
+constexpr const char* code_names[] = { "gamma", "delta", "rice", "expgolomb" };
+
+void write_header(std::ostream& os, elias_code mode, size_t order)
+{
+    os << "ELIAS";
+    os.put(static_cast<char>(mode));
+    os.put(static_cast<char>(mode == elias_code::expgolomb ? order : 0));
+}
+
+// False, with a message, if the file is not an elias one or was written with another code
+bool check_header(std::istream& is, elias_code mode, size_t order)
+{
+    char magic[5];
+    if (!is.read(magic, 5) || std::string_view(magic, 5) != "ELIAS") {
+        std::println(std::cerr, "Error: not an elias file");
+        return false;
+    }
+    size_t code = static_cast<uint8_t>(is.get());
+    size_t k = static_cast<uint8_t>(is.get());
+    if (!is || code > 3) {
+        std::println(std::cerr, "Error: unknown code in the header");
+        return false;
+    }
+    if (code != static_cast<size_t>(mode) || (mode == elias_code::expgolomb && k != order)) {
+        std::println(std::cerr, "Error: the file was written with -m {}{}, decode it with the same options", code_names[code],
+            code == static_cast<size_t>(elias_code::expgolomb) ? " -k " + std::to_string(k) : "");
+        return false;
+    }
+    return true;
+}
+
+// The whole string must be a number from 0 to 16
+bool parse_order(std::string_view val, size_t& order)
+{
+    auto [ptr, ec] = std::from_chars(val.data(), val.data() + val.size(), order);
+    return ec == std::errc() && ptr == val.data() + val.size() && !val.empty() && order <= 16;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
+    if (argc == 2 && std::string_view(argv[1]) == "t") {
+        return self_test() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (argc < 4) {
         std::println(std::cerr, "Error: not enough params");
         return EXIT_FAILURE;
     }
 
+    elias_code mode = elias_code::gamma;
+    size_t order = 0;
+    for (int i = 4; i < argc; i += 2) {
+        std::string opt = argv[i];
+        std::string val = (i + 1 < argc) ? argv[i + 1] : "";
+        if (opt == "-m" && val == "gamma") { mode = elias_code::gamma; }
+        else if (opt == "-m" && val == "delta") { mode = elias_code::delta; }
+        else if (opt == "-m" && val == "rice") { mode = elias_code::rice; }
+        else if (opt == "-m" && val == "expgolomb") { mode = elias_code::expgolomb; }
+        else if (opt == "-k" && parse_order(val, order)) {}
+        else {
+            std::println(std::cerr, "Error with the options: use -m gamma|delta|rice|expgolomb and -k <order> (0 to 16)");
+            return EXIT_FAILURE;
+        }
+    }
+
     if (*argv[1] != 'c' && *argv[1] != 'd') {
         std::println(std::cerr, "Error with the first param: use 'c' or 'd' instead");
         return EXIT_FAILURE;
     }
 
     if (*argv[1]=='c'){ // Compression
-        std::ifstream input(argv[2] /*, std::ios::binary*/);
+        fdistream input(argv[2]);
         if (!input)
         {
             std::println(std::cerr, "Error opening {}", argv[2]);
             return EXIT_FAILURE;
         }
 
-        std::ofstream output(argv[3], std::ios::binary);
+        fdostream output(argv[3]);
         if (!output) {
             std::println(std::cerr, "Error opening {}", argv[3]);
             return EXIT_FAILURE;
         }
 
-        int j = 0;
-        int elias;
-        int number;
-        std::bitset<8> buffer;
-
-        while (input >> number){
-            if (number >= 0){    // Positive
-                elias = number * 2 + 1;
-            }else{   // Negative
-                elias = - number * 2;
-            }
-
-            // Coding
-            int bit = (number == 0) ? 1 : (static_cast<int>(std::floor(std::sqrt(elias))))*2 + 1;
-            std::bitset<128> bits(elias);
-            std::string binary = bits.to_string().substr(128 - bit);
-            if (DEBUG) {std::cout << "elias representation of " << number << " is " << binary << std::endl;}
-
-            // Write
-            for (int i = 0; i < bit; i++){
-                buffer[j] = (binary[i] == '1');
-                if (j++ == 7){
-                    write_byte(output, buffer);
-                    j = 0;
-                }
-            }
-        }
-        while (j < 8){
-            buffer[j] = 0;
-            if (j++ == 7){
-                write_byte(output, buffer);
-            }
+        write_header(output, mode, order);
+        bitwriter bw(output);
+        elias_encoder encoder(bw, mode, order);
+        int_reader reader(input);
+        int32_t number;
+        while (reader(number)){
+            encoder(number);
         }
 
     }else{  // Decompression
-        std::ifstream input(argv[2], std::ios::binary);
+        fdistream input(argv[2]);
         if (!input)
         {
             std::println(std::cerr, "Error opening {}", argv[2]);
             return EXIT_FAILURE;
         }
 
-        std::ofstream output(argv[3] /*, std::ios::binary*/);
+        if (!check_header(input, mode, order)) {
+            return EXIT_FAILURE;
+        }
+
+        fdostream output(argv[3]);
         if (!output) {
             std::println(std::cerr, "Error opening {}", argv[3]);
             return EXIT_FAILURE;
         }
 
-        int num = -1;
-        int i = 0;
-        std::bitset<8> buffer;
-        std::string bits = "";
-        
-        while ((buffer = read_byte(input))!=0){
-            int j = 0;
-            while (j != 8){
-                bits += (buffer[j++] == 1) ? '1' : '0'; 
-                if (bits[i] == '1' && num == -1){num = i * 2 + 1;}
-                if (++i == num){
-                    unsigned long longValue = std::stoul(bits, nullptr, 2);
-                    int intValue = static_cast<int>(longValue);
-                    int elias = (intValue%2 == 0) ? -intValue/2 : (intValue-1)/2;
-
-                    if (DEBUG) {std::cout << "value -> " << elias << std::endl;}
-                    
-                    output << elias << std::endl;
-                    
-                    i = 0;
-                    num = -1;
-                    bits.clear();
-                }
-            }
+        bitreader br(input);
+        elias_decoder decoder(br, mode, order);
+        int_writer writer(output);
+        int32_t number;
+        while (decoder(number)){
+            writer(number, "\n");
         }
     }
 
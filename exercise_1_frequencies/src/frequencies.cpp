@@ -3,6 +3,9 @@
 #include <fstream>
 #include <set>
 #include <map>
+#include <vector>
+#include <string>
+#include "fdstream.h"
 
 // #include <iomanip>  // for setw()
 
@@ -23,14 +26,14 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
-    std::ifstream input(argv[1] , std::ios::binary);
+    fdistream input(argv[1]);
     if (!input)
     {
         std::println(std::cerr, "Error opening {}", argv[1]);
         return EXIT_FAILURE;
     }
 
-    std::ofstream output(argv[2]);
+    fdostream output(argv[2]);
     if (!output) {
         std::cerr << "Error opening output file";
         return EXIT_FAILURE;
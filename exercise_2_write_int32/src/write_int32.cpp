@@ -2,6 +2,15 @@
 #include <iostream>
 #include <fstream>
 #include <cstdint>  // For int32_t
+#include <vector>
+#include <string>
+#include <charconv>
+#include <cstring>
+#include <span>
+#include <bit>
+#include <array>
+#include "fdstream.h"
+#include "int_io.h"
 
 /*Write a command line program in C++ with this syntax:
 write_int32 <filein.txt> <fileout.bin>
@@ -12,23 +21,66 @@ parameter, with the same numbers saved as 32-bit binary little endian numbers in
 template<typename T>
 std::ostream& raw_write(std::ostream& os, const T& val, size_t size = sizeof(T))
 {
-    return os.write(reinterpret_cast<const char*>(val), size);
+    return os.write(reinterpret_cast<const char*>(&val), size);
 }
 
+// The file is little endian: only a big endian host has to swap the bytes
+inline void to_little_endian(std::span<int32_t> values)
+{
+    if constexpr (std::endian::native == std::endian::big) {
+        for (auto& v : values) {
+            v = std::byteswap(v);
+        }
+    }
+}
+
+// CRC-32 (the zlib/PNG one, reflected polynomial 0xEDB88320), to validate the output with --checksum
+struct crc32 {
+    std::array<uint32_t, 256> table_;
+    uint32_t crc_ = 0xFFFFFFFF;
+
+    crc32() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table_[i] = c;
+        }
+    }
+
+    void operator()(const void* data, size_t size) {
+        auto p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            crc_ = table_[(crc_ ^ p[i]) & 0xFF] ^ (crc_ >> 8);
+        }
+    }
+
+    uint32_t value() const { return crc_ ^ 0xFFFFFFFF; }
+};
+
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::println("Usage: {} <filein.txt> <fileout.txt>", argv[0]);
+    // write_int32 <filein.txt> <fileout.bin> [--count|--checksum]
+    // --count appends the number of values, --checksum the CRC-32 of the values, both as a
+    // 32-bit little endian number after the data
+    if (argc != 3 && argc != 4) {
+        std::println("Usage: {} <filein.txt> <fileout.txt> [--count|--checksum]", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string trailer = (argc == 4) ? argv[3] : "";
+    if (trailer != "" && trailer != "--count" && trailer != "--checksum") {
+        std::println("Usage: {} <filein.txt> <fileout.txt> [--count|--checksum]", argv[0]);
         return EXIT_FAILURE;
     }
 
-    std::ifstream inputFile(argv[1]);
+    fdistream inputFile(argv[1]);
     if (!inputFile) 
     {
         std::println("Usage: {} <filein.txt> <fileout.txt>", argv[0]);
         return EXIT_FAILURE;
     }
 
-    std::ofstream outputFile(argv[2], std::ios::binary);
+    fdostream outputFile(argv[2]);
     if (!outputFile) {
         std::cerr << "Error opening output file";
         return EXIT_FAILURE;
@@ -40,10 +92,40 @@ int main(int argc, char* argv[]) {
     //     outputFile.write(reinterpret_cast<char*>(&num32), sizeof(int32_t));
     // }
 
-     int number;
+    // int number;
     // There is no need to cast to int32_t...
-    while (inputFile >> number) {
-        outputFile.write(reinterpret_cast<const char*>(&number), sizeof(int32_t));    //sizeof(int32_t) = 4
+    //while (inputFile >> number) {
+    //    outputFile.write(reinterpret_cast<const char*>(&number), sizeof(int32_t));    //sizeof(int32_t) = 4
+    //}
+
+    // Bulk version: parse a block of 1M values into a contiguous buffer, then a single write for it
+    std::vector<int32_t> block(1 << 20);
+    int_reader reader(inputFile);
+    uint32_t count = 0;
+    crc32 crc;
+    while (true) {
+        size_t n = 0;
+        while (n < block.size() && reader(block[n])) {
+            ++n;
+        }
+        if (n == 0) {
+            break;
+        }
+        to_little_endian({ block.data(), n });
+        raw_write(outputFile, block[0], n * sizeof(int32_t));
+        count += static_cast<uint32_t>(n);
+        if (trailer == "--checksum") {
+            crc(block.data(), n * sizeof(int32_t));
+        }
+        if (n < block.size()) {
+            break;
+        }
+    }
+
+    if (trailer != "") {
+        int32_t value = static_cast<int32_t>(trailer == "--count" ? count : crc.value());
+        to_little_endian({ &value, 1 });
+        raw_write(outputFile, value);
     }
 
     // --------------------------------- LESSON ---------------------------------
@@ -2,6 +2,14 @@
 #include <iostream>
 #include <fstream>
 #include <cstdint>  // For int32_t
+#include <vector>
+#include <string>
+#include <charconv>
+#include <span>
+#include <bit>
+#include <thread>
+#include <algorithm>
+#include "fdstream.h"
 
 /*Write a command line program in C++ with this syntax:
 read_int32 <filein.bin> <fileout.txt>
@@ -13,29 +21,83 @@ numbers saved in decimal text format separated by a new line.*/
 
 /*PPS: use vecotrs*/
 
+// The file is little endian: only a big endian host has to swap the bytes
+inline void from_little_endian(std::span<int32_t> values)
+{
+    if constexpr (std::endian::native == std::endian::big) {
+        for (auto& v : values) {
+            v = std::byteswap(v);
+        }
+    }
+}
+
+// Format the values with std::to_chars, each followed by a space (at most 12 chars per int32_t)
+void format_chunk(std::span<const int32_t> values, std::vector<char>& out)
+{
+    out.resize(values.size() * 12);
+    char* p = out.data();
+    for (const auto& v : values) {
+        p = std::to_chars(p, p + 11, v).ptr;
+        *p++ = ' ';
+    }
+    out.resize(p - out.data());
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 3) {
         std::println("Usage: {} <filein.txt> <fileout.txt>", argv[0]);
         return EXIT_FAILURE;
     }
 
-    std::ifstream inputFile(argv[1], std::ios::binary);
+    fdistream inputFile(argv[1]);
     if (!inputFile) 
     {
         std::println("Usage: {} <filein.txt> <fileout.txt>", argv[0]);
         return EXIT_FAILURE;
     }
 
-    std::ofstream outputFile(argv[2]/*, std::ios::binary*/);
+    fdostream outputFile(argv[2]);
     if (!outputFile) {
         std::cerr << "Error opening output file";
         return EXIT_FAILURE;
     }
 
-    int32_t number32;
-    while (inputFile.read(reinterpret_cast<char*>(&number32), sizeof(int32_t))) {
-        //int number = static_cast<int>(number32);      // int cast isn't required from int32_t
-        outputFile << number32 << " ";
+    //int32_t number32;
+    //while (inputFile.read(reinterpret_cast<char*>(&number32), sizeof(int32_t))) {
+    //    //int number = static_cast<int>(number32);      // int cast isn't required from int32_t
+    //    outputFile << number32 << " ";
+    //}
+
+    // Bulk version: 16 MiB of values with a single read, formatted by all the cores in parallel
+    // (each thread gets a contiguous chunk, the chunks are then written in order)
+    const size_t block = 1 << 22;
+    const size_t min_chunk = 1 << 16;
+    const size_t nthreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int32_t> values(block);
+    std::vector<std::vector<char>> text(nthreads);
+
+    while (inputFile.read(reinterpret_cast<char*>(values.data()), block * sizeof(int32_t)) || inputFile.gcount() > 0) {
+        size_t n = inputFile.gcount() / sizeof(int32_t);    // an incomplete value at the end is ignored
+        if (n == 0) {
+            break;
+        }
+        from_little_endian({ values.data(), n });
+
+        size_t nchunks = std::min(nthreads, (n + min_chunk - 1) / min_chunk);
+        size_t chunk = (n + nchunks - 1) / nchunks;
+        {
+            std::vector<std::jthread> workers;
+            for (size_t t = 0; t < nchunks; ++t) {
+                size_t first = std::min(n, t * chunk);
+                size_t last = std::min(n, first + chunk);
+                workers.emplace_back([&, t, first, last] {
+                    format_chunk({ values.data() + first, last - first }, text[t]);
+                });
+            }
+        }
+        for (size_t t = 0; t < nchunks; ++t) {
+            outputFile.write(text[t].data(), text[t].size());
+        }
     }
 
     // --------------------------------- LESSON ---------------------------------
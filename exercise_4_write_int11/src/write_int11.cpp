@@ -1,7 +1,16 @@
 #include <iostream>
 #include <fstream>
-#include <bitset>
-#include <cmath>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <bit>
+#include <vector>
+#include <string>
+#include <charconv>
+#include <cstring>
+#include "fdstream.h"
+#include "int_io.h"
 
 /*Write a command line program in C++ with this syntax:
 write_int11 <filein.txt> <fileout.bin>
@@ -14,90 +23,228 @@ another value.*/
 
 /*PS: write a 1byte writer whit an 8bit buffer*/
 
-std::ostream& write_byte(std::ostream& os, std::bitset<8>& buffer)
+/*Generalized to any width from 1 to 32 bits:
+    write_int11 <filein.txt> <fileout.bin> [--width <N>|auto]
+
+The default width is 11, as above. With "--width auto" the program picks the smallest width that holds
+all the values, and writes a header before the data: the width in 1 byte and the number of values as a
+32-bit little endian integer (read_int11 needs "--width auto" too). Without the header, below 8 bits the
+padding of the last byte may be read back as extra zeros.
+
+Frame of reference:
+    write_int11 <filein.txt> <fileout.bin> --for
+
+The values are split in blocks of 128. Each block stores its minimum and the deltas from it, packed at the
+smallest width that holds the largest delta, so clustered values take a few bits each, wherever they are.
+The file is:
+    count        32 bit LE, number of values
+    index        32 bit LE for each block, byte offset of the block from the end of the index
+    blocks       minimum (32 bit LE), width (1 byte, 0 if all the values are equal), packed deltas
+The deltas are packed as above, in two groups of 64, each one padded to a whole byte. With the index,
+a reader can jump to any block without decoding the ones before it.*/
+
+// Packing works on blocks of 64 values: at W bits they fill exactly W 64-bit words, stored big endian
+// so that the bits end up in the file from the most significant to the least significant. The width
+// is a template parameter, so each kernel is fully unrolled with constant shifts.
+template<size_t W>
+void pack_block(const uint32_t* in, uint64_t* out)
+{
+    constexpr uint64_t mask = (uint64_t(1) << W) - 1;
+    uint64_t acc = 0;
+    size_t bits = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        uint64_t v = in[i] & mask;
+        if (bits + W <= 64) {
+            acc = (acc << W) | v;
+            bits += W;
+            if (bits == 64) {
+                *out++ = acc;
+                acc = 0;
+                bits = 0;
+            }
+        }
+        else {
+            size_t room = 64 - bits;
+            *out++ = (acc << room) | (v >> (W - room));
+            acc = v;
+            bits = W - room;
+        }
+    }
+}
+
+using pack_fn = void(*)(const uint32_t*, uint64_t*);
+
+template<size_t... W>
+constexpr std::array<pack_fn, sizeof...(W) + 1> make_pack_table(std::index_sequence<W...>)
+{
+    return { nullptr, &pack_block<W + 1>... };
+}
+constexpr auto pack_table = make_pack_table(std::make_index_sequence<32>{});
+
+// Pack n (<= 64) values at width bits, and write only the bytes that hold them (the rest is 0 padding)
+void write_block(std::ostream& os, std::array<uint32_t, 64>& in, size_t n, size_t width)
+{
+    std::array<uint64_t, 32> out;
+    std::fill(in.begin() + n, in.end(), 0);
+    pack_table[width](in.data(), out.data());
+    if constexpr (std::endian::native == std::endian::little) {
+        for (size_t i = 0; i < width; ++i) {
+            out[i] = std::byteswap(out[i]);
+        }
+    }
+    os.write(reinterpret_cast<const char*>(out.data()), (n * width + 7) / 8);
+}
+
+// Smallest 2's complement width for the range [lo, hi]
+size_t min_width(int32_t lo, int32_t hi)
+{
+    size_t w = 1;
+    while (w < 32 && (lo < -(int64_t(1) << (w - 1)) || hi > (int64_t(1) << (w - 1)) - 1)) {
+        ++w;
+    }
+    return w;
+}
+
+void write_u32le(std::ostream& os, uint32_t x)
 {
-    return os.write(reinterpret_cast<const char*>(&buffer), 1);
+    for (int i = 0; i < 32; i += 8) {
+        os.put(static_cast<char>(x >> i));
+    }
+}
+
+constexpr size_t for_block_size = 128;
+
+// Bytes taken by the deltas of a block of n values packed at width bits
+size_t for_packed_bytes(size_t n, size_t width)
+{
+    size_t full = n / 64, rest = n % 64;
+    return full * 8 * width + (rest * width + 7) / 8;
+}
+
+void write_for(std::ostream& os, const std::vector<int32_t>& values)
+{
+    size_t nblocks = (values.size() + for_block_size - 1) / for_block_size;
+    std::vector<int32_t> mins(nblocks);
+    std::vector<uint8_t> widths(nblocks);
+    for (size_t b = 0; b < nblocks; ++b) {
+        auto first = values.begin() + b * for_block_size;
+        auto last = values.begin() + std::min(values.size(), (b + 1) * for_block_size);
+        auto [lo, hi] = std::minmax_element(first, last);
+        mins[b] = *lo;
+        widths[b] = static_cast<uint8_t>(std::bit_width(static_cast<uint32_t>(*hi) - static_cast<uint32_t>(*lo)));
+    }
+
+    write_u32le(os, static_cast<uint32_t>(values.size()));
+    uint32_t offset = 0;
+    for (size_t b = 0; b < nblocks; ++b) {
+        write_u32le(os, offset);
+        size_t n = std::min(for_block_size, values.size() - b * for_block_size);
+        offset += static_cast<uint32_t>(5 + for_packed_bytes(n, widths[b]));
+    }
+
+    std::array<uint32_t, 64> block;
+    for (size_t b = 0; b < nblocks; ++b) {
+        write_u32le(os, static_cast<uint32_t>(mins[b]));
+        os.put(static_cast<char>(widths[b]));
+        if (widths[b] == 0) {
+            continue;
+        }
+        size_t end = std::min(values.size(), (b + 1) * for_block_size);
+        for (size_t i = b * for_block_size; i < end; i += 64) {
+            size_t n = std::min<size_t>(64, end - i);
+            for (size_t j = 0; j < n; ++j) {
+                block[j] = static_cast<uint32_t>(values[i + j]) - static_cast<uint32_t>(mins[b]);
+            }
+            write_block(os, block, n, widths[b]);
+        }
+    }
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <filein.txt> <fileout.bin>" << std::endl;
+    if (argc < 3 || argc > 5 || (argc == 4 && std::string(argv[3]) != "--for")) {
+        std::cerr << "Usage: " << argv[0] << " <filein.txt> <fileout.bin> [--width <N>|auto|--for]" << std::endl;
         return EXIT_FAILURE;
     }
+    size_t width = 11;
+    bool auto_width = false;
+    bool frame_of_reference = argc == 4;
+    if (argc == 5) {
+        std::string opt = argv[3], val = argv[4];
+        if (opt != "--width") {
+            std::cerr << "Usage: " << argv[0] << " <filein.txt> <fileout.bin> [--width <N>|auto|--for]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (val == "auto") {
+            auto_width = true;
+        }
+        else if (std::from_chars(val.data(), val.data() + val.size(), width).ec != std::errc() || width < 1 || width > 32) {
+            std::cerr << "The width must be between 1 and 32, or auto" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    std::ifstream inputFile(argv[1]);
+    fdistream inputFile(argv[1]);
     if (!inputFile) {
         std::cerr << "Error opening input file: " << argv[1] << std::endl;
         return EXIT_FAILURE;
     }
 
-    std::ofstream outputFile(argv[2], std::ios::binary);
+    fdostream outputFile(argv[2]);
     if (!outputFile) {
         std::cerr << "Error opening output file: " << argv[2] << std::endl;
         return EXIT_FAILURE;
     }
 
-    int number;
-    std::bitset<11> bits;
-    std::bitset<8> buffer;
-    
-// LITTLE endian
-    int j = 0;
-
-    while (inputFile >> number)
-    {
-        if (number < -1024 | number > 1023)
-        {
-            std::cout << "the number " << number << " is too big for 11 bits compression and will be skipped." << std::endl;
-            continue;
+    int32_t number;
+    int_reader reader(inputFile);
+    std::array<uint32_t, 64> block;
+    size_t n = 0;
+
+    if (frame_of_reference) {
+        std::vector<int32_t> values;
+        while (reader(number)) {
+            values.push_back(number);
         }
-        
-        bits = number;
-
-        for (int i = 0; i < 11; i++)
-        {
-            buffer[j]=bits[i];
-            if(j++==7){
-                write_byte(outputFile, buffer);
-                j=0;
+        write_for(outputFile, values);
+        return EXIT_SUCCESS;
+    }
+
+    if (auto_width) {
+        // The width depends on all the values: read them first
+        std::vector<int32_t> values;
+        while (reader(number)) {
+            values.push_back(number);
+        }
+        auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+        width = values.empty() ? 1 : min_width(*lo, *hi);
+        outputFile.put(static_cast<char>(width));
+        write_u32le(outputFile, static_cast<uint32_t>(values.size()));
+        for (const auto& x : values) {
+            block[n++] = static_cast<uint32_t>(x);
+            if (n == 64) {
+                write_block(outputFile, block, n, width);
+                n = 0;
             }
         }
     }
-    while(j<8){
-        buffer[j] = 0;
-        if(j++==7){
-            write_byte(outputFile, buffer);
+    else {
+        int64_t lo = -(int64_t(1) << (width - 1));
+        int64_t hi = (int64_t(1) << (width - 1)) - 1;
+        while (reader(number)) {
+            if (number < lo || number > hi) {
+                std::cerr << "the number " << number << " is too big for " << width << " bits compression and will be skipped." << std::endl;
+                continue;
+            }
+            block[n++] = static_cast<uint32_t>(number);
+            if (n == 64) {
+                write_block(outputFile, block, n, width);
+                n = 0;
+            }
         }
     }
-
-// BIG endian
-//    int j = 8;
-//
-//    while (inputFile >> number)
-//    {
-//        if (number < -1024 | number > 1023)
-//        {
-//            std::cout << "the number " << number << " is too big for 11 bits compression and will be skipped." << std::endl;
-//            continue;
-//        }
-//        
-//        bits = number;
-//
-//        for (int i = 0; i < 11; i++)
-//        {
-//            buffer[--j]=bits[i];
-//            if(j==0){
-//                write_byte(outputFile, buffer);
-//                j=8;
-//            }
-//        }
-//    }
-//    while(j>0){
-//        buffer[--j] = 0;
-//        if(j==0){
-//            write_byte(outputFile, buffer);
-//        }
-//    }
+    if (n > 0) {
+        write_block(outputFile, block, n, width);
+    }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
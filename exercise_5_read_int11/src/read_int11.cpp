@@ -1,8 +1,17 @@
 #include <iostream>
 #include <fstream>
-#include <bitset>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <bit>
 #include <vector>
-#include <cmath>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include "fdstream.h"
+#include "int_io.h"
 
 /*Write a command line program in C ++ with this syntax:
 read_int11 <filein.bin> <fileout.txt>
@@ -11,62 +20,241 @@ bits sorted from most significant to least significant. The program must create
 passed as the second parameter, with the same numbers saved in decimal text format separated by a new
 line. Ignore any excess bits in the last byte.*/
 
-std::bitset<8> read_byte(std::ifstream& is)
+// Inverse of pack_block in write_int11: W big endian 64-bit words give back 64 values of W bits.
+// The values come out unsigned: plain packing sign extends them, frame of reference adds the minimum.
+template<size_t W>
+void unpack_block(const uint64_t* in, uint32_t* out)
 {
-    unsigned char byte;
-    is.read(reinterpret_cast<char*>(&byte), 1);
-    return std::bitset<8>(byte);
+    constexpr uint64_t mask = (uint64_t(1) << W) - 1;
+    uint64_t acc = 0;
+    size_t bits = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        uint64_t v;
+        if (bits >= W) {
+            v = acc >> (bits - W);
+            bits -= W;
+        }
+        else {
+            uint64_t next = *in++;
+            size_t missing = W - bits;
+            v = (acc << missing) | (next >> (64 - missing));
+            acc = next;
+            bits = 64 - missing;
+        }
+        out[i] = static_cast<uint32_t>(v & mask);
+    }
+}
+
+using unpack_fn = void(*)(const uint64_t*, uint32_t*);
+
+template<size_t... W>
+constexpr std::array<unpack_fn, sizeof...(W) + 1> make_unpack_table(std::index_sequence<W...>)
+{
+    return { nullptr, &unpack_block<W + 1>... };
 }
+constexpr auto unpack_table = make_unpack_table(std::make_index_sequence<32>{});
+
+// Copy n (<= 64) values packed at width bits from p, padding the missing words with zeros, and unpack them
+void read_block(const char* p, size_t n, size_t width, uint32_t* out)
+{
+    std::array<uint64_t, 32> in{};
+    std::memcpy(in.data(), p, (n * width + 7) / 8);
+    if constexpr (std::endian::native == std::endian::little) {
+        for (size_t i = 0; i < width; ++i) {
+            in[i] = std::byteswap(in[i]);
+        }
+    }
+    unpack_table[width](in.data(), out);
+}
+
+uint32_t read_u32le(const char* p)
+{
+    uint32_t x = 0;
+    for (int i = 0; i < 4; ++i) {
+        x |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return x;
+}
+
+// Frame of reference file, as written by "write_int11 --for": the index gives the position of every
+// block of 128 values, so any range can be decoded without touching the blocks before it.
+class for_reader {
+    static constexpr size_t block_size = 128;
+    const std::vector<char>& data_;
+    size_t count_ = 0;
+    size_t nblocks_ = 0;
+    size_t blocks_start_ = 0;
+
+public:
+    for_reader(const std::vector<char>& data) : data_(data) {
+        if (data_.size() < 4) {
+            return;
+        }
+        count_ = read_u32le(data_.data());
+        nblocks_ = (count_ + block_size - 1) / block_size;
+        blocks_start_ = 4 + 4 * nblocks_;
+    }
+
+    bool valid() const {
+        if (data_.size() < 4 || data_.size() < blocks_start_) {
+            return false;
+        }
+        for (size_t b = 0; b < nblocks_; ++b) {
+            size_t offset = blocks_start_ + read_u32le(data_.data() + 4 + 4 * b);
+            size_t n = std::min(block_size, count_ - b * block_size);
+            if (offset + 5 > data_.size() || static_cast<unsigned char>(data_[offset + 4]) > 32) {
+                return false;
+            }
+            size_t width = data_[offset + 4];
+            if (offset + 5 + (n / 64) * 8 * width + ((n % 64) * width + 7) / 8 > data_.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const { return count_; }
+
+    // Decode block b into out (up to 128 values), returns how many values it holds
+    size_t block(size_t b, int32_t* out) const {
+        const char* p = data_.data() + blocks_start_ + read_u32le(data_.data() + 4 + 4 * b);
+        uint32_t min = read_u32le(p);
+        size_t width = static_cast<unsigned char>(p[4]);
+        p += 5;
+        size_t n = std::min(block_size, count_ - b * block_size);
+        std::array<uint32_t, block_size> deltas{};
+        if (width > 0) {
+            for (size_t i = 0; i < n; i += 64) {
+                size_t k = std::min<size_t>(64, n - i);
+                read_block(p, k, width, deltas.data() + i);
+                p += (k * width + 7) / 8;
+            }
+        }
+        // A plain loop over the block, the compiler vectorizes it
+        for (size_t i = 0; i < block_size; ++i) {
+            out[i] = static_cast<int32_t>(min + deltas[i]);
+        }
+        return n;
+    }
+
+    // Decode the values from first (included) to last (excluded)
+    template<typename F>
+    void range(size_t first, size_t last, F&& f) const {
+        last = std::min(last, count_);
+        std::array<int32_t, block_size> values;
+        for (size_t b = first / block_size; b * block_size < last; ++b) {
+            size_t n = block(b, values.data());
+            size_t i = b * block_size < first ? first - b * block_size : 0;
+            size_t end = std::min(n, last - b * block_size);
+            for (; i < end; ++i) {
+                f(values[i]);
+            }
+        }
+    }
+};
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <filein.txt> <fileout.bin>" << std::endl;
+    bool frame_of_reference = argc >= 4 && std::string(argv[3]) == "--for";
+    if (argc < 3 || argc > 6 || (argc == 4 && !frame_of_reference) || (argc == 6 && !frame_of_reference)) {
+        std::cerr << "Usage: " << argv[0] << " <filein.bin> <fileout.txt> [--width <N>|auto|--for [<first> <count>]]" << std::endl;
         return EXIT_FAILURE;
     }
+    size_t width = 11;
+    bool auto_width = false;
+    size_t first = 0, count_for = SIZE_MAX;
+    if (argc == 6) {
+        std::string_view f = argv[4], c = argv[5];
+        if (std::from_chars(f.data(), f.data() + f.size(), first).ec != std::errc() ||
+            std::from_chars(c.data(), c.data() + c.size(), count_for).ec != std::errc()) {
+            std::cerr << "Usage: " << argv[0] << " <filein.bin> <fileout.txt> [--width <N>|auto|--for [<first> <count>]]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (argc == 5) {
+        std::string opt = argv[3], val = argv[4];
+        if (opt != "--width") {
+            std::cerr << "Usage: " << argv[0] << " <filein.bin> <fileout.txt> [--width <N>|auto|--for [<first> <count>]]" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (val == "auto") {
+            auto_width = true;
+        }
+        else if (std::from_chars(val.data(), val.data() + val.size(), width).ec != std::errc() || width < 1 || width > 32) {
+            std::cerr << "The width must be between 1 and 32, or auto" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
-    std::ifstream inputFile(argv[1], std::ios::binary);
+    fdistream inputFile(argv[1]);
     if (!inputFile) {
         std::cerr << "Error opening input file: " << argv[1] << std::endl;
         return EXIT_FAILURE;
     }
 
-    std::ofstream outputFile(argv[2]/*, std::ios::binary*/);
+    fdostream outputFile(argv[2]);
     if (!outputFile) {
         std::cerr << "Error opening output file: " << argv[2] << std::endl;
         return EXIT_FAILURE;
     }
 
-    std::bitset<8> buffer;
-    std::bitset<11> bits;
-    
-// LITTLE endian
-    int j = 0;
-
-    while ((buffer = read_byte(inputFile))!=0)
-    {
-       for(int i = 0; i<8; i++)
-       {
-            bits[j] = buffer[i];
-            if(++j==11)
-            {
-                unsigned long longValue = bits.to_ulong();
-                int intValue = static_cast<int>(longValue);
-                outputFile << intValue << " ";
-                j = 0;
-            }
-       }
+    std::vector<char> data;
+    while (true) {
+        size_t n = data.size();
+        data.resize(n + (1 << 20));
+        inputFile.read(data.data() + n, 1 << 20);
+        data.resize(n + inputFile.gcount());
+        if (!inputFile) {
+            break;
+        }
     }
-    while(j<11)
-    {
-        bits[j]=0;
-        if(++j==11)
-        {
-            unsigned long longValue = bits.to_ulong();
-            int intValue = static_cast<int>(longValue);
-            outputFile << intValue;
+
+    if (frame_of_reference) {
+        for_reader reader(data);
+        if (!reader.valid()) {
+            std::cerr << "Invalid frame of reference file: " << argv[1] << std::endl;
+            return EXIT_FAILURE;
         }
+        int_writer writer(outputFile);
+        size_t last = count_for > reader.size() - std::min(first, reader.size()) ? reader.size() : first + count_for;
+        reader.range(first, last, [&](int32_t x) { writer(x, " "); });
+        return EXIT_SUCCESS;
+    }
 
+    size_t offset = 0;
+    size_t count;
+    if (auto_width) {
+        if (data.size() < 5 || data[0] < 1 || data[0] > 32) {
+            std::cerr << "Invalid header in input file: " << argv[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+        width = data[0];
+        count = 0;
+        for (int i = 0; i < 4; ++i) {
+            count |= size_t(static_cast<unsigned char>(data[1 + i])) << (8 * i);
+        }
+        offset = 5;
+        if (count * width > (data.size() - offset) * 8) {
+            std::cerr << "Input file is truncated: " << argv[1] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    else {
+        // Without a count, every whole value in the file is read (less than 8 padding bits are left)
+        count = (data.size() * 8) / width;
+    }
+
+    int_writer writer(outputFile);
+    std::array<uint32_t, 64> out;
+    for (size_t done = 0; done < count; done += 64) {
+        // The last block is usually partial: read_block pads it with zeros
+        size_t n = std::min<size_t>(64, count - done);
+        read_block(data.data() + offset, n, width, out.data());
+        offset += (n * width + 7) / 8;
+        for (size_t i = 0; i < n; ++i) {
+            int32_t x = static_cast<int32_t>(out[i] << (32 - width)) >> (32 - width);
+            writer(x, done + i + 1 < count ? " " : "");
+        }
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -15,10 +15,12 @@
 #include <bit>
 #include <unordered_map>
 #include <algorithm>
+#include <utility>
 #include <format>
-#include <queue>
 #include <memory>
 
+#include "fdstream.h"
+
 using rgb = std::array<uint8_t, 3>;
 using grayscale = std::array<uint8_t, 1>;
 using diff = std::array<uint16_t, 1>;
@@ -126,29 +128,7 @@ struct huffman {
 			left_(left), right_(right) {
 		}
 	};
-	struct nodeptr {
-		static inline int id = 0;
-		int id_;
-		node* p_;
-
-		nodeptr(node* p) : p_(p), id_(id++) {}
-		operator node* () { return p_; }
-
-		//const node* operator->() const { return p_; }
-		//node* operator->() { return p_; }
-
-		// deducing this
-		template<typename Self>
-		auto&& operator->(this Self&& self) { return self.p_; }
 
-		bool operator<(const nodeptr& other) const {
-			if (p_->freq_ == other->freq_) {
-				return id_ > other.id_;
-			}
-			return p_->freq_ > other->freq_;
-		}
-	};
-	
 	void make_codes(node* n, uint32_t code, uint32_t len) {
 		if (n->left_ == nullptr) {
 			n->code_ = code;
@@ -161,31 +141,92 @@ struct huffman {
 		}
 	}
 
-	std::unordered_map<uint8_t, node*> map_;
-	std::vector<std::unique_ptr<node>> mem_;
+	std::unordered_map<T, node*> map_;
+	// All the nodes of the tree: the leaves first, then the internal nodes in creation order.
+	// The capacity is fixed before building, so node pointers never move.
+	std::vector<node> arena_;
 
-	template<typename It>
-	huffman(It first, It last) {
-		auto f = std::for_each(first, last, frequency<uint8_t>{});
+	// Two-queue method: both the leaves and the internal nodes are already sorted by frequency,
+	// so the smallest node is always at the front of one of them (no priority queue needed).
+	node* pop_min(size_t& leaf, size_t& inner, size_t nleaves) {
+		if (leaf < nleaves && (inner == arena_.size() || arena_[leaf].freq_ <= arena_[inner].freq_)) {
+			return &arena_[leaf++];
+		}
+		return &arena_[inner++];
+	}
 
-		std::priority_queue<nodeptr> nodes;
+	// Build the tree for the given (symbol, frequency) list, sorted by frequency. Returns the length
+	// of the longest code.
+	uint32_t build(const std::vector<std::pair<T, uint32_t>>& freqs) {
+		size_t nleaves = freqs.size();
+		map_.clear();
+		arena_.clear();
+		arena_.reserve(2 * nleaves - 1);
+		for (const auto& [sym, freq] : freqs) {
+			arena_.emplace_back(sym, freq);
+		}
 
-		for (const auto& [sym, freq] : f.counter_) {
-			mem_.push_back(std::make_unique<node>(sym, freq));
-			nodes.push(mem_.back().get());
+		size_t leaf = 0, inner = nleaves;
+		while (arena_.size() < 2 * nleaves - 1) {
+			auto n1 = pop_min(leaf, inner, nleaves);
+			auto n2 = pop_min(leaf, inner, nleaves);
+			arena_.emplace_back(n1, n2);
 		}
-		while (nodes.size() > 1) {
-			auto n1 = nodes.top();
-			nodes.pop();
-			auto n2 = nodes.top();
-			nodes.pop();
-			mem_.push_back(std::make_unique<node>(n1, n2));
-			nodes.push(mem_.back().get());
+
+		make_codes(&arena_.back(), 0, 0);
+		uint32_t maxlen = 0;
+		for (size_t i = 0; i < nleaves; ++i) {
+			maxlen = std::max(maxlen, arena_[i].len_);
+		}
+		return maxlen;
+	}
+
+	// Codes are at most max_len bits long (the length fields are 5 bit and the codes are handled in
+	// 32 bit): when a skewed distribution needs longer ones, the frequencies are halved (keeping them
+	// at least 1) and the tree is rebuilt, which flattens it a little at each round.
+	template<typename It>
+	huffman(It first, It last, uint32_t max_len = 31) {
+		auto f = std::for_each(first, last, frequency<T>{});
+		if (f.counter_.empty()) {
+			return;
 		}
-		auto root = nodes.top();
-		nodes.pop();
 
-		make_codes(root, 0, 0);
+		std::vector<std::pair<T, uint32_t>> freqs(f.counter_.begin(), f.counter_.end());
+		// Ties are broken on the symbol, so the codes do not depend on the hash map order
+		std::sort(freqs.begin(), freqs.end(), [](const auto& a, const auto& b) {
+			return a.second != b.second ? a.second < b.second : a.first < b.first;
+		});
+		while (build(freqs) > max_len) {
+			for (auto& [sym, freq] : freqs) {
+				freq = (freq + 1) / 2;
+			}
+		}
+	}
+	// The map points into arena_
+	huffman(const huffman&) = delete;
+	huffman& operator=(const huffman&) = delete;
+
+	// Reassign the codes in canonical order (by length, then by symbol): the decoder can rebuild
+	// them from the lengths alone. Returns the leaves in that order.
+	std::vector<node*> canonical() {
+		std::vector<node*> nodes;
+		for (const auto& [sym, n] : map_) {
+			if (n->len_ == 0) {
+				n->len_ = 1; // a single symbol still needs one bit
+			}
+			nodes.push_back(n);
+		}
+		std::sort(nodes.begin(), nodes.end(), [](const node* a, const node* b) {
+			return a->len_ != b->len_ ? a->len_ < b->len_ : a->sym_ < b->sym_;
+		});
+		uint32_t code = 0;
+		uint32_t len = nodes.empty() ? 0 : nodes.front()->len_;
+		for (auto n : nodes) {
+			code <<= n->len_ - len;
+			len = n->len_;
+			n->code_ = code++;
+		}
+		return nodes;
 	}
 
 	auto begin() { return map_.begin(); }
@@ -194,6 +235,77 @@ struct huffman {
 	auto operator[](const T& sym) { return map_[sym]; }
 };
 
+// Compact length table for canonical codes (large alphabets): the symbols are listed grouped by
+// code length, so each one costs symbits and there is no code field at all. The huffman tree keeps
+// the codes within 31 bits, the most MaxLen (and the 32 bit decoder) can hold.
+//     MaxLen      5 bit
+//     for len = 1..MaxLen:
+//         Count   symbits+1 bit
+//         Symbols Count x symbits bit, sorted
+template<typename T>
+void write_length_table(bitwriter& bw, const std::vector<typename huffman<T>::node*>& nodes, size_t symbits)
+{
+	uint32_t maxlen = nodes.empty() ? 0 : nodes.back()->len_;
+	if (maxlen > 31) {
+		exit(EXIT_FAILURE);
+	}
+	bw(maxlen, 5);
+	size_t pos = 0;
+	for (uint32_t len = 1; len <= maxlen; ++len) {
+		uint32_t count = 0;
+		while (pos + count < nodes.size() && nodes[pos + count]->len_ == len) {
+			++count;
+		}
+		bw(count, symbits + 1);
+		for (uint32_t i = 0; i < count; ++i) {
+			bw(static_cast<uint32_t>(nodes[pos + i]->sym_), symbits);
+		}
+		pos += count;
+	}
+}
+
+template<typename T>
+struct canonical_decoder {
+	std::vector<T> syms_;           // sorted by (len, sym)
+	std::vector<uint32_t> first_;   // first code of each length
+	std::vector<uint32_t> count_;   // number of codes of each length
+	std::vector<uint32_t> offset_;  // index in syms_ of the first code of each length
+
+	canonical_decoder(bitreader& br, size_t symbits) {
+		uint32_t maxlen;
+		br(maxlen, 5);
+		first_.resize(maxlen + 1);
+		count_.resize(maxlen + 1);
+		offset_.resize(maxlen + 1);
+		uint32_t code = 0;
+		for (uint32_t len = 1; len <= maxlen; ++len) {
+			br(count_[len], symbits + 1);
+			first_[len] = code;
+			offset_[len] = static_cast<uint32_t>(syms_.size());
+			for (uint32_t i = 0; i < count_[len]; ++i) {
+				uint32_t sym;
+				br(sym, symbits);
+				syms_.push_back(static_cast<T>(sym));
+			}
+			code = (code + count_[len]) << 1;
+		}
+	}
+
+	T operator()(bitreader& br) const {
+		uint32_t code = 0;
+		for (size_t len = 1; len < count_.size(); ++len) {
+			uint32_t bit;
+			br(bit, 1);
+			code = (code << 1) | bit;
+			// Codes of the same length are consecutive (unsigned wrap-around rejects code < first)
+			if (code - first_[len] < count_[len]) {
+				return syms_[offset_[len] + code - first_[len]];
+			}
+		}
+		exit(EXIT_FAILURE);
+	}
+};
+
 //--------------------------------------------------------------------------------------------//
 
 template<typename T>
@@ -236,7 +348,7 @@ struct mat {
 
 template<typename T>
 bool PAMwrite(std::string_view filename, const mat<T>& img){
-    std::ofstream os(filename.data(), std::ios::binary);
+    fdostream os{ std::string(filename) };
     if (!os) {
         return false;
     }
@@ -251,7 +363,7 @@ bool PAMwrite(std::string_view filename, const mat<T>& img){
 
 template<typename T>
 std::expected<mat<T>, std::string> PAMread(const std::string& filename){
-    std::ifstream is(filename, std::ios::binary);
+    fdistream is(filename);
     if(!is){
         return std::unexpected("ERROR OPEN FILE");
     }
@@ -373,6 +485,58 @@ std::vector<std::array<uint16_t, 1>> bytes_to_pam_diff_codes(const std::vector<u
     return result;
 }
 
+// Residuals are in [-255, 255], so 9 bit in 2's complement are enough to code them as single symbols
+constexpr size_t diff_bits = 9;
+
+std::vector<uint16_t> pam_diff_codes_to_symbols(const mat<diff>& img) {
+    std::vector<uint16_t> result;
+    result.reserve(img.size());
+
+    for (const auto& pixel : img.data_) {
+        result.push_back(static_cast<uint16_t>(pixel[0] & 0x1FF));
+    }
+
+    return result;
+}
+
+std::vector<diff> symbols_to_pam_diff_codes(const std::vector<uint16_t>& symbols) {
+    std::vector<diff> result;
+    result.reserve(symbols.size());
+
+    for (const auto& sym : symbols) {
+        uint16_t value = (sym & 0x100) ? (sym | 0xFE00) : sym;  // sign extension
+        result.push_back({ value });
+    }
+
+    return result;
+}
+
+// Optional zero-run stage: a run of r zero residuals becomes the escape symbol zrun_base + bit_width(r) - 1,
+// followed by the bits of r below the leading one. Flat areas then cost a few bits per run, not one per pixel.
+constexpr uint16_t zrun_base = 1 << diff_bits;
+constexpr size_t zrun_bits = diff_bits + 1;
+constexpr uint8_t flag_zero_runs = 1;
+
+std::vector<uint16_t> zero_run_encode(const std::vector<uint16_t>& symbols, std::vector<uint32_t>& runs) {
+    std::vector<uint16_t> result;
+
+    for (size_t i = 0; i < symbols.size();) {
+        if (symbols[i] != 0) {
+            result.push_back(symbols[i++]);
+            continue;
+        }
+        uint32_t run = 0;
+        while (i < symbols.size() && symbols[i] == 0) {
+            ++run;
+            ++i;
+        }
+        result.push_back(static_cast<uint16_t>(zrun_base + std::bit_width(run) - 1));
+        runs.push_back(run);
+    }
+
+    return result;
+}
+
 mat<std::array<uint8_t, 1>> PAMrevdiff(const mat<std::array<uint16_t, 1>>& img){
 	mat<std::array<uint8_t, 1>> new_img(img.rows(), img.cols());
         
@@ -393,15 +557,103 @@ mat<std::array<uint8_t, 1>> PAMrevdiff(const mat<std::array<uint16_t, 1>>& img){
 
 //--------------------------------------------------------------------------------------------//
 
-void compress(const std::string& infile, const std::string& outfile)
+/* HUFFDIF2 format, the residuals are coded natively as SymBits wide symbols:
+    Field           Size                        Description
+    MagicNumber     8 byte                      "HUFFDIF2"
+    Width           32 bit unsigned
+    Height          32 bit unsigned
+    Flags           8 bit                       bit 0: zero-run escapes (flag_zero_runs)
+    SymBits         8 bit                       bits per symbol (9, or 10 with zero-run escapes), at most 16
+    LengthTable     see write_length_table      canonical Huffman code lengths
+    NumSymbols      32 bit unsigned             number of coded symbols (a zero run counts as one)
+    Data            NumSymbols Huffman codes    each zero-run escape is followed by its extra bits
+*/
+void compress_native(const mat<diff>& img, const std::string& outfile, bool zero_runs)
 {
 	using namespace std;
-	using namespace std::literals;
 
-	ifstream is(infile, std::ios::binary);
-	if (!is) {
+	vector<uint16_t> v = pam_diff_codes_to_symbols(img);
+	vector<uint32_t> runs;
+	if (zero_runs) {
+		v = zero_run_encode(v, runs);
+	}
+	size_t symbits = zero_runs ? zrun_bits : diff_bits;
+
+	huffman<uint16_t> h(begin(v), end(v));
+	auto nodes = h.canonical();
+
+	fdostream os(outfile);
+	if (!os) {
 		exit(EXIT_FAILURE);
 	}
+	os << "HUFFDIF2";
+	raw_write<uint32_t>(os, static_cast<uint32_t>(img.cols()));
+	raw_write<uint32_t>(os, static_cast<uint32_t>(img.rows()));
+	os.put(zero_runs ? flag_zero_runs : 0);
+	os.put(static_cast<char>(symbits));
+
+	bitwriter bw(os);
+	write_length_table<uint16_t>(bw, nodes, symbits);
+	bw(static_cast<uint32_t>(v.size()), 32);
+	auto run = runs.begin();
+	for (const auto& x : v) {
+		auto n = h[x];
+		bw(n->code_, n->len_);
+		if (x >= zrun_base) {
+			bw(*run++, x - zrun_base);
+		}
+	}
+}
+
+void decompress_native(std::istream& is, const std::string& outfile, uint32_t width, uint32_t height)
+{
+	using namespace std;
+
+	uint8_t flags = static_cast<uint8_t>(is.get());
+	size_t symbits = is.get();
+	if (symbits == 0 || symbits > 16) {
+		exit(EXIT_FAILURE);
+	}
+
+	bitreader br(is);
+	canonical_decoder<uint16_t> dec(br, symbits);
+	uint32_t n;
+	br(n, 32);
+
+	size_t npixels = size_t(width) * height;
+	vector<uint16_t> symbols;
+	symbols.reserve(npixels);
+	for (uint32_t i = 0; i < n; ++i) {
+		uint16_t sym = dec(br);
+		if ((flags & flag_zero_runs) && sym >= zrun_base) {
+			uint32_t k = sym - zrun_base;
+			if (k > 31) {
+				exit(EXIT_FAILURE);
+			}
+			uint32_t extra;
+			br(extra, k);
+			uint32_t run = (1u << k) | extra;
+			if (run > npixels - symbols.size()) {
+				exit(EXIT_FAILURE);
+			}
+			symbols.insert(symbols.end(), run, 0);
+		}
+		else {
+			symbols.push_back(sym);
+		}
+	}
+	if (symbols.size() != npixels) {
+		exit(EXIT_FAILURE);
+	}
+	mat<diff> img(height, width);
+	img.data_ = symbols_to_pam_diff_codes(symbols);
+	PAMwrite(outfile, PAMrevdiff(img));
+}
+
+void compress(const std::string& infile, const std::string& outfile, bool native = false, bool zero_runs = false)
+{
+	using namespace std;
+	using namespace std::literals;
 
     /*
 	is.seekg(0, ios::end);
@@ -413,8 +665,15 @@ void compress(const std::string& infile, const std::string& outfile)
     */
 
     auto res = PAMread<grayscale>(infile);
+    if (!res) {
+        exit(EXIT_FAILURE);
+    }
     auto& img = res.value();
     auto new_img = PAMdiff(img);
+    if (native) {
+        compress_native(new_img, outfile, zero_runs);
+        return;
+    }
     std::vector<uint8_t> v = pam_diff_codes_to_bytes(new_img);
 
 	huffman<uint8_t> h(begin(v), end(v));
@@ -438,7 +697,7 @@ void compress(const std::string& infile, const std::string& outfile)
 	}
 	*/
 
-	ofstream os(outfile, std::ios::binary);
+	fdostream os(outfile);
 	if (!os) {
 		exit(EXIT_FAILURE);
 	}
@@ -470,7 +729,7 @@ void decompress(const std::string& infile, const std::string& outfile)
 {
 	using namespace std;
 
-	ifstream is(infile, std::ios::binary);
+	fdistream is(infile);
 	if (!is) {
 		exit(EXIT_FAILURE);
 	}
@@ -485,6 +744,10 @@ void decompress(const std::string& infile, const std::string& outfile)
 	raw_read(is, header[0], 8); // OK
     raw_read<uint32_t>(is, width);
     raw_read<uint32_t>(is, height);
+    if (header == "HUFFDIF2") {
+        decompress_native(is, outfile, width, height);
+        return;
+    }
 	size_t table_len = is.get();
 	if (table_len == 0) {
 		table_len = 256;
@@ -552,11 +815,27 @@ int main(int argc, char* argv[]){
 	using namespace std;
 	using namespace std::literals;
 
-	if (argc != 4) {
+	// huffdiff [c|d] <input file> <output file> [--native] [--zero-runs]
+	// "-" as input or output file stands for stdin/stdout
+	if (argc < 4) {
 		return EXIT_FAILURE;
 	}
+	bool native = false;
+	bool zero_runs = false;
+	for (int i = 4; i < argc; ++i) {
+		if (argv[i] == "--native"s) {
+			native = true;
+		}
+		else if (argv[i] == "--zero-runs"s) {
+			native = true; // escapes need the wider alphabet
+			zero_runs = true;
+		}
+		else {
+			return EXIT_FAILURE;
+		}
+	}
 	if (argv[1] == "c"s) {
-		compress(argv[2], argv[3]);
+		compress(argv[2], argv[3], native, zero_runs);
 	}
 	else if (argv[1] == "d"s) {
 		decompress(argv[2], argv[3]);
@@ -6,15 +6,18 @@
 #include <ranges>
 #include <string>
 #include <bit>
+#include <charconv>
 #include <unordered_map>
 #include <algorithm>
+#include <utility>
 #include <iostream>
 #include <format>
-#include <queue>
 #include <memory>
 
 #include <print>
 
+#include "fdstream.h"
+
 /*Write a command line program in C++ with this syntax:
     huffman1 [c|d] <input file> <output file>
 
@@ -39,6 +42,20 @@ Then it produces a file with the following format:
 When the "d" option is specified, the program decompresses the contents of the input file (check that it’s
 stored in the previous format) and saves it in the output file.*/
 
+/*Streaming mode:
+    huffman1 c <input file> <output file> --block <KiB>
+
+The input is compressed in a single pass, one block of <KiB> KiB at a time (less than 4 GiB, as the block
+length is a 32 bit field), each with its own Huffman codes, so it works on pipes too ("-" stands for
+stdin/stdout). Every block is flushed as soon as it is coded, so the latency is bounded by the block size. "d" recognizes the format from the magic number.
+    Field           Size                        Description
+    MagicNumber     8 byte                      "HUFFMANS"
+    then for each block:
+    BlockSymbols    32 bit unsigned big endian  Number of symbols in the block (0 marks the end of the stream)
+    LengthTable     see write_length_table      Canonical Huffman code lengths of the block
+    Data            BlockSymbols Huffman codes  Padded with 0 to the next byte*/
+
+
 #define print(...) std::cout << std::format(__VA_ARGS__);
 #define println(...) std::cout << std::format(__VA_ARGS__) << "\n";
 
@@ -116,6 +133,11 @@ public:
 		return is_;
 	}
 
+	// Drop the bits left in the current byte
+	void align() {
+		n_ = 0;
+	}
+
 	operator bool() const {
 		return is_.good();
 	}
@@ -145,29 +167,7 @@ struct huffman {
 			left_(left), right_(right) {
 		}
 	};
-	struct nodeptr {
-		static inline int id = 0;
-		int id_;
-		node* p_;
-
-		nodeptr(node* p) : p_(p), id_(id++) {}
-		operator node* () { return p_; }
-
-		//const node* operator->() const { return p_; }
-		//node* operator->() { return p_; }
 
-		// deducing this
-		template<typename Self>
-		auto&& operator->(this Self&& self) { return self.p_; }
-
-		bool operator<(const nodeptr& other) const {
-			if (p_->freq_ == other->freq_) {
-				return id_ > other.id_;
-			}
-			return p_->freq_ > other->freq_;
-		}
-	};
-	
 	void make_codes(node* n, uint32_t code, uint32_t len) {
 		if (n->left_ == nullptr) {
 			n->code_ = code;
@@ -180,31 +180,92 @@ struct huffman {
 		}
 	}
 
-	std::unordered_map<uint8_t, node*> map_;
-	std::vector<std::unique_ptr<node>> mem_;
+	std::unordered_map<T, node*> map_;
+	// All the nodes of the tree: the leaves first, then the internal nodes in creation order.
+	// The capacity is fixed before building, so node pointers never move.
+	std::vector<node> arena_;
 
-	template<typename It>
-	huffman(It first, It last) {
-		auto f = std::for_each(first, last, frequency<uint8_t>{});
+	// Two-queue method: both the leaves and the internal nodes are already sorted by frequency,
+	// so the smallest node is always at the front of one of them (no priority queue needed).
+	node* pop_min(size_t& leaf, size_t& inner, size_t nleaves) {
+		if (leaf < nleaves && (inner == arena_.size() || arena_[leaf].freq_ <= arena_[inner].freq_)) {
+			return &arena_[leaf++];
+		}
+		return &arena_[inner++];
+	}
 
-		std::priority_queue<nodeptr> nodes;
+	// Build the tree for the given (symbol, frequency) list, sorted by frequency. Returns the length
+	// of the longest code.
+	uint32_t build(const std::vector<std::pair<T, uint32_t>>& freqs) {
+		size_t nleaves = freqs.size();
+		map_.clear();
+		arena_.clear();
+		arena_.reserve(2 * nleaves - 1);
+		for (const auto& [sym, freq] : freqs) {
+			arena_.emplace_back(sym, freq);
+		}
 
-		for (const auto& [sym, freq] : f.counter_) {
-			mem_.push_back(std::make_unique<node>(sym, freq));
-			nodes.push(mem_.back().get());
+		size_t leaf = 0, inner = nleaves;
+		while (arena_.size() < 2 * nleaves - 1) {
+			auto n1 = pop_min(leaf, inner, nleaves);
+			auto n2 = pop_min(leaf, inner, nleaves);
+			arena_.emplace_back(n1, n2);
 		}
-		while (nodes.size() > 1) {
-			auto n1 = nodes.top();
-			nodes.pop();
-			auto n2 = nodes.top();
-			nodes.pop();
-			mem_.push_back(std::make_unique<node>(n1, n2));
-			nodes.push(mem_.back().get());
+
+		make_codes(&arena_.back(), 0, 0);
+		uint32_t maxlen = 0;
+		for (size_t i = 0; i < nleaves; ++i) {
+			maxlen = std::max(maxlen, arena_[i].len_);
 		}
-		auto root = nodes.top();
-		nodes.pop();
+		return maxlen;
+	}
 
-		make_codes(root, 0, 0);
+	// Codes are at most max_len bits long (the length fields are 5 bit and the codes are handled in
+	// 32 bit): when a skewed distribution needs longer ones, the frequencies are halved (keeping them
+	// at least 1) and the tree is rebuilt, which flattens it a little at each round.
+	template<typename It>
+	huffman(It first, It last, uint32_t max_len = 31) {
+		auto f = std::for_each(first, last, frequency<T>{});
+		if (f.counter_.empty()) {
+			return;
+		}
+
+		std::vector<std::pair<T, uint32_t>> freqs(f.counter_.begin(), f.counter_.end());
+		// Ties are broken on the symbol, so the codes do not depend on the hash map order
+		std::sort(freqs.begin(), freqs.end(), [](const auto& a, const auto& b) {
+			return a.second != b.second ? a.second < b.second : a.first < b.first;
+		});
+		while (build(freqs) > max_len) {
+			for (auto& [sym, freq] : freqs) {
+				freq = (freq + 1) / 2;
+			}
+		}
+	}
+	// The map points into arena_
+	huffman(const huffman&) = delete;
+	huffman& operator=(const huffman&) = delete;
+
+	// Reassign the codes in canonical order (by length, then by symbol): the decoder can rebuild
+	// them from the lengths alone. Returns the leaves in that order.
+	std::vector<node*> canonical() {
+		std::vector<node*> nodes;
+		for (const auto& [sym, n] : map_) {
+			if (n->len_ == 0) {
+				n->len_ = 1; // a single symbol still needs one bit
+			}
+			nodes.push_back(n);
+		}
+		std::sort(nodes.begin(), nodes.end(), [](const node* a, const node* b) {
+			return a->len_ != b->len_ ? a->len_ < b->len_ : a->sym_ < b->sym_;
+		});
+		uint32_t code = 0;
+		uint32_t len = nodes.empty() ? 0 : nodes.front()->len_;
+		for (auto n : nodes) {
+			code <<= n->len_ - len;
+			len = n->len_;
+			n->code_ = code++;
+		}
+		return nodes;
 	}
 
 	auto begin() { return map_.begin(); }
@@ -213,23 +274,160 @@ struct huffman {
 	auto operator[](const T& sym) { return map_[sym]; }
 };
 
+// Compact length table for canonical codes: the symbols are listed grouped by code length,
+// so each one costs symbits and there is no code field at all.
+//     MaxLen      5 bit
+//     for len = 1..MaxLen:
+//         Count   symbits+1 bit
+//         Symbols Count x symbits bit, sorted
+template<typename T>
+void write_length_table(bitwriter& bw, const std::vector<typename huffman<T>::node*>& nodes, size_t symbits)
+{
+	uint32_t maxlen = nodes.empty() ? 0 : nodes.back()->len_;
+	bw(maxlen, 5);
+	size_t pos = 0;
+	for (uint32_t len = 1; len <= maxlen; ++len) {
+		uint32_t count = 0;
+		while (pos + count < nodes.size() && nodes[pos + count]->len_ == len) {
+			++count;
+		}
+		bw(count, symbits + 1);
+		for (uint32_t i = 0; i < count; ++i) {
+			bw(static_cast<uint32_t>(nodes[pos + i]->sym_), symbits);
+		}
+		pos += count;
+	}
+}
+
+template<typename T>
+struct canonical_decoder {
+	std::vector<T> syms_;           // sorted by (len, sym)
+	std::vector<uint32_t> first_;   // first code of each length
+	std::vector<uint32_t> count_;   // number of codes of each length
+	std::vector<uint32_t> offset_;  // index in syms_ of the first code of each length
+
+	canonical_decoder(bitreader& br, size_t symbits) {
+		uint32_t maxlen;
+		br(maxlen, 5);
+		first_.resize(maxlen + 1);
+		count_.resize(maxlen + 1);
+		offset_.resize(maxlen + 1);
+		uint32_t code = 0;
+		for (uint32_t len = 1; len <= maxlen; ++len) {
+			br(count_[len], symbits + 1);
+			first_[len] = code;
+			offset_[len] = static_cast<uint32_t>(syms_.size());
+			for (uint32_t i = 0; i < count_[len]; ++i) {
+				uint32_t sym;
+				br(sym, symbits);
+				syms_.push_back(static_cast<T>(sym));
+			}
+			code = (code + count_[len]) << 1;
+		}
+	}
+
+	T operator()(bitreader& br) const {
+		uint32_t code = 0;
+		for (size_t len = 1; len < count_.size(); ++len) {
+			uint32_t bit;
+			br(bit, 1);
+			code = (code << 1) | bit;
+			// Codes of the same length are consecutive (unsigned wrap-around rejects code < first)
+			if (code - first_[len] < count_[len]) {
+				return syms_[offset_[len] + code - first_[len]];
+			}
+		}
+		exit(EXIT_FAILURE);
+	}
+};
+
 
 
+void compress_stream(const std::string& infile, const std::string& outfile, size_t block_size)
+{
+	using namespace std;
+
+	fdistream is(infile);
+	if (!is) {
+		exit(EXIT_FAILURE);
+	}
+
+	fdostream os(outfile);
+	if (!os) {
+		exit(EXIT_FAILURE);
+	}
+
+	os << "HUFFMANS";
+	bitwriter bw(os);
+	vector<uint8_t> v(block_size);
+	while (true) {
+		raw_read(is, v[0], block_size);
+		auto n = static_cast<uint32_t>(is.gcount());
+		if (n == 0) {
+			break;
+		}
+		huffman<uint8_t> h(begin(v), begin(v) + n);
+		auto nodes = h.canonical();
+
+		bw(n, 32);
+		write_length_table<uint8_t>(bw, nodes, 8);
+		for (uint32_t i = 0; i < n; ++i) {
+			auto node = h[v[i]];
+			bw(node->code_, node->len_);
+		}
+		bw.flush();
+		os.flush();
+	}
+	bw(0, 32);
+}
+
+void decompress_stream(std::istream& is, const std::string& outfile)
+{
+	using namespace std;
+
+	fdostream os(outfile);
+	if (!os) {
+		exit(EXIT_FAILURE);
+	}
+
+	bitreader br(is);
+	vector<uint8_t> v;
+	while (true) {
+		uint32_t n;
+		br(n, 32);
+		if (!br || n == 0) {
+			break;
+		}
+		canonical_decoder<uint8_t> dec(br, 8);
+		v.resize(n);
+		for (uint32_t i = 0; i < n; ++i) {
+			v[i] = dec(br);
+		}
+		raw_write(os, v[0], n);
+		os.flush();
+		br.align();
+	}
+}
+
 void compress(const std::string& infile, const std::string& outfile)
 {
 	using namespace std;
 	using namespace std::literals;
 
-	ifstream is(infile, std::ios::binary);
+	fdistream is(infile);
 	if (!is) {
 		exit(EXIT_FAILURE);
 	}
 
-	is.seekg(0, ios::end);
-	auto filesize = is.tellg();
-	is.seekg(0);
-	vector<uint8_t> v(filesize);
-	raw_read(is, v[0], filesize);
+	// No seekg to get the size: the input may be a pipe
+	vector<uint8_t> v;
+	size_t filesize = 0;
+	do {
+		v.resize(filesize + (1 << 20));
+		raw_read(is, v[filesize], 1 << 20);
+		filesize += is.gcount();
+	} while (is);
+	v.resize(filesize);
 
 	huffman<uint8_t> h(begin(v), end(v));
 
@@ -241,8 +439,12 @@ void compress(const std::string& infile, const std::string& outfile)
 		[](const huffman<uint8_t>::node* a, const huffman<uint8_t>::node* b) {
 			return a->len_ < b->len_;
 		});
+	// The table goes to stdout, unless that is where the compressed data goes
 	for (const auto& n: nodes) {
-		if (isprint(n->sym_)) {
+		if (outfile == "-") {
+			break;
+		}
+		else if (isprint(n->sym_)) {
 			println("{:c} {:0{}b}", n->sym_, n->code_, n->len_);
 		}
 		else {
@@ -250,7 +452,7 @@ void compress(const std::string& infile, const std::string& outfile)
 		}
 	}
 
-	ofstream os(outfile, std::ios::binary);
+	fdostream os(outfile);
 	if (!os) {
 		exit(EXIT_FAILURE);
 	}
@@ -274,7 +476,7 @@ void decompress(const std::string& infile, const std::string& outfile)
 {
 	using namespace std;
 
-	ifstream is(infile, std::ios::binary);
+	fdistream is(infile);
 	if (!is) {
 		exit(EXIT_FAILURE);
 	}
@@ -285,6 +487,13 @@ void decompress(const std::string& infile, const std::string& outfile)
 	// is.read(&header[0], 8); // OK
 	// is.read(header.data(), 8); // OK
 	raw_read(is, header[0], 8); // OK
+	if (header == "HUFFMANS") {
+		decompress_stream(is, outfile);
+		return;
+	}
+	if (header != "HUFFMAN1") {
+		exit(EXIT_FAILURE);
+	}
 	size_t table_len = is.get();
 	if (table_len == 0) {
 		table_len = 256;
@@ -308,7 +517,7 @@ void decompress(const std::string& infile, const std::string& outfile)
 			return get<2>(a) < get<2>(b);
 		});
 
-	ofstream os(outfile, std::ios::binary);
+	fdostream os(outfile);
 	if (!os) {
 		exit(EXIT_FAILURE);
 	}
@@ -343,17 +552,35 @@ int main(int argc, char* argv[])
 		using namespace std;
 		using namespace std::literals;
 
-		if (argc != 4) {
+		auto usage = [] {
+			cerr << "Usage: huffman1 c|d <input file> <output file>\n"
+			        "       huffman1 c <input file> <output file> --block <KiB>\n";
 			return EXIT_FAILURE;
+		};
+		if (argc != 4 && argc != 6) {
+			return usage();
+		}
+		size_t block_kib = 0;
+		if (argc == 6) {
+			string_view val = argv[5];
+			auto [ptr, ec] = from_chars(val.data(), val.data() + val.size(), block_kib);
+			if (argv[1] != "c"s || argv[4] != "--block"s || ec != errc{} || ptr != val.data() + val.size() || block_kib == 0 || block_kib >= (1 << 22)) {
+				return usage();
+			}
 		}
 		if (argv[1] == "c"s) {
-			compress(argv[2], argv[3]);
+			if (block_kib > 0) {
+				compress_stream(argv[2], argv[3], block_kib * 1024);
+			}
+			else {
+				compress(argv[2], argv[3]);
+			}
 		}
 		else if (argv[1] == "d"s) {
 			decompress(argv[2], argv[3]);
 		}
 		else {
-			return EXIT_FAILURE;
+			return usage();
 		}
 	}
 	_CrtDumpMemoryLeaks();
@@ -7,10 +7,28 @@
 #include <algorithm>
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <format>
 #include <print>
 #include <set>  // a set is a sorted container
+#include <queue>
+#include <random>
+#include <tuple>
+#include <climits>
+#include <cstdlib>
+#include <utility>
+#include <thread>
+#include <future>
+#include <memory>
+#include <filesystem>
+#if defined(__SSSE3__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "int_io.h"
 
 template <typename T>
 // Functor
@@ -37,23 +55,700 @@ std::vector<int> read(std::istream& is)
     if (is.good())
     {
         int num;
-        while (is >> num) {
+        int_reader reader(is);
+        while (reader(num)) {
             v.push_back(num);
         }
     }
     return v;
 }
 
+// Binary output for sorted lists: the differences between consecutive values, zigzag mapped so that
+// negative steps stay small too, stored as Stream VByte varints. The file is:
+//     "SVBDELTA"   magic
+//     count        32 bit LE, number of values
+//     control      1 byte every 4 values, 2 bits for each one (from the least significant): length - 1
+//     data         1 to 4 little endian bytes for each value
+// The lengths are kept apart from the data, so a decoder can read 4 values at a time without branches.
+void write_svb(std::ostream& os, const int* v, size_t n)
+{
+    std::vector<uint8_t> control((n + 3) / 4, 0);
+    std::vector<uint8_t> data;
+    data.reserve(n * 4);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t delta = static_cast<uint32_t>(v[i]) - prev;
+        prev = static_cast<uint32_t>(v[i]);
+        uint32_t zz = (delta << 1) ^ (0u - (delta >> 31));
+        uint32_t len = 1 + (zz > 0xff) + (zz > 0xffff) + (zz > 0xffffff);
+        control[i / 4] |= static_cast<uint8_t>((len - 1) << (2 * (i % 4)));
+        for (uint32_t b = 0; b < len; ++b) {
+            data.push_back(static_cast<uint8_t>(zz >> (8 * b)));
+        }
+    }
+    os.write("SVBDELTA", 8);
+    for (int i = 0; i < 32; i += 8) {
+        os.put(static_cast<char>(n >> i));
+    }
+    os.write(reinterpret_cast<const char*>(control.data()), control.size());
+    os.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// Decoder for write_svb. Each control byte tells the length of the next 4 values: with SSSE3 a single
+// shuffle, from a table indexed by the control byte, spreads their bytes in 4 32-bit lanes.
+// Without it, every value is read as 4 bytes and masked to its length. The data is padded with 16
+// bytes, so both can read past the last value.
+struct svb_tables {
+    uint8_t length[256];
+    uint8_t shuffle[256][16];
+
+    svb_tables() {
+        for (int c = 0; c < 256; ++c) {
+            int pos = 0;
+            for (int i = 0; i < 4; ++i) {
+                int len = ((c >> (2 * i)) & 3) + 1;
+                for (int b = 0; b < 4; ++b) {
+                    shuffle[c][4 * i + b] = b < len ? static_cast<uint8_t>(pos + b) : 0x80;
+                }
+                pos += len;
+            }
+            length[c] = static_cast<uint8_t>(pos);
+        }
+    }
+};
+
+bool read_svb(std::istream& is, std::vector<int>& v)
+{
+    std::vector<uint8_t> file{ std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>() };
+    if (file.size() < 12 || std::memcmp(file.data(), "SVBDELTA", 8) != 0) {
+        return false;
+    }
+    size_t n = 0;
+    for (int i = 0; i < 4; ++i) {
+        n |= size_t(file[8 + i]) << (8 * i);
+    }
+    size_t ncontrol = (n + 3) / 4;
+    if (file.size() - 12 < ncontrol) {
+        return false;
+    }
+    static const svb_tables tables;
+    const uint8_t* control = file.data() + 12;
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        total += ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    }
+    if (file.size() - 12 - ncontrol < total) {
+        return false;
+    }
+    file.resize(file.size() + 16);
+    control = file.data() + 12;
+    const uint8_t* data = control + ncontrol;
+
+    std::vector<uint32_t> zz(n + 3);
+    size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX__)
+    for (; i + 4 <= n; i += 4) {
+        uint8_t c = control[i / 4];
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[c]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(zz.data() + i), _mm_shuffle_epi8(bytes, mask));
+        data += tables.length[c];
+    }
+#endif
+    for (; i < n; ++i) {
+        uint32_t len = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t x = 0;
+        for (uint32_t b = 0; b < 4; ++b) {
+            x |= uint32_t(data[b]) << (8 * b);
+        }
+        zz[i] = len == 4 ? x : x & ((1u << (8 * len)) - 1);
+        data += len;
+    }
+
+    // Undo the zigzag mapping and the differences
+    v.resize(n);
+    uint32_t prev = 0;
+    for (size_t j = 0; j < n; ++j) {
+        prev += (zz[j] >> 1) ^ (0u - (zz[j] & 1));
+        v[j] = static_cast<int>(prev);
+    }
+    return true;
+}
+
+int compare_ints(const void* a, const void* b)
+{
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Counting sort for values in a narrow range (like the -1000..1000 of the int11 exercises): one pass
+// counts every value, one writes them back in order. It is used automatically when the range is not
+// wider than the number of values; the counters are 32 bit (n < 2^32), so the histogram is never
+// larger than the data. Returns false, leaving v untouched, when the range is too wide.
+bool counting_sort(int* v, size_t n)
+{
+    if (n < 2 || n > UINT32_MAX) {
+        return false;
+    }
+    auto [lo, hi] = std::minmax_element(v, v + n);
+    int64_t min = *lo;
+    uint64_t range = static_cast<uint64_t>(int64_t(*hi) - min) + 1;
+    if (range > n) {
+        return false;
+    }
+    std::vector<uint32_t> count(range, 0);
+    for (size_t i = 0; i < n; ++i) {
+        ++count[v[i] - min];
+    }
+    int* out = v;
+    for (uint64_t d = 0; d < range; ++d) {
+        out = std::fill_n(out, count[d], static_cast<int>(min + static_cast<int64_t>(d)));
+    }
+    return true;
+}
+
+// LSD radix sort on 11-bit digits: 3 passes for 32 bits instead of a comparison (and an indirect call)
+// for every step of qsort. Flipping the sign bit makes the signed order the same as the unsigned one.
+// All the digit counts come from a single read of the keys, and a pass where every key has the same
+// digit would not move anything, so it is skipped (small ranges often need a single pass).
+void radix_sort(int* v, size_t n)
+{
+    constexpr int bits = 11, passes = 3;
+    constexpr uint32_t radix = 1u << bits, mask = radix - 1;
+    if (n < 2) {
+        return;
+    }
+    std::vector<size_t> count(passes * radix, 0);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t key = static_cast<uint32_t>(v[i]) ^ 0x80000000u;
+        for (int p = 0; p < passes; ++p) {
+            ++count[p * radix + ((key >> (p * bits)) & mask)];
+        }
+    }
+    std::vector<int> tmp(n);
+    int* src = v;
+    int* dst = tmp.data();
+    for (int p = 0; p < passes; ++p) {
+        size_t* c = &count[p * radix];
+        uint32_t first = ((static_cast<uint32_t>(src[0]) ^ 0x80000000u) >> (p * bits)) & mask;
+        if (c[first] == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (uint32_t d = 0; d < radix; ++d) {
+            size_t x = c[d];
+            c[d] = sum;
+            sum += x;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t key = static_cast<uint32_t>(src[i]) ^ 0x80000000u;
+            dst[c[(key >> (p * bits)) & mask]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != v) {
+        std::memcpy(v, src, n * sizeof(int));
+    }
+}
+
+// sort_io --bench <N>: qsort, std::sort and radix_sort on the same N random integers, over the whole
+// int range and over 0..65535 (where radix_sort skips its last pass). Needs about 12 bytes per value.
+void bench(size_t n)
+{
+    std::mt19937 rng(12345);
+    std::vector<int> data(n);
+    std::vector<int> v;
+    for (auto [name, lo, hi] : { std::tuple{ "full range", INT_MIN, INT_MAX }, std::tuple{ "0..65535", 0, 65535 } }) {
+        std::uniform_int_distribution<int> dist(lo, hi);
+        std::generate(begin(data), end(data), [&] { return dist(rng); });
+        auto time = [&](const char* algo, auto sorter) {
+            v = data;
+            auto start = std::chrono::steady_clock::now();
+            sorter(v);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::println("{:>10} {:>10} {:8.3f} s{}", name, algo, elapsed.count(), std::ranges::is_sorted(v) ? "" : " NOT SORTED");
+        };
+        time("qsort", [](std::vector<int>& v) { std::qsort(v.data(), v.size(), sizeof(int), compare_ints); });
+        time("std::sort", [](std::vector<int>& v) { std::sort(begin(v), end(v)); });
+        time("radix", [](std::vector<int>& v) { radix_sort(v.data(), v.size()); });
+    }
+}
+
+// ------------------------------ Parallel mode (--threads) ------------------------------
+// Parse, sort and format all run on nthreads threads. Each stage splits its data in equal contiguous
+// slices, one for each thread, like read_int32 does for formatting: the work per value is uniform, so
+// a static split keeps all the cores busy without the cost of a task queue.
+
+// Run f(t) for every t in [0, nthreads): t = 0 on the calling thread, the others on jthreads
+template<typename F>
+void parallel_for(size_t nthreads, F&& f)
+{
+    std::vector<std::jthread> workers;
+    for (size_t t = 1; t < nthreads; ++t) {
+        workers.emplace_back([&f, t] { f(t); });
+    }
+    f(0);
+}
+
+bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+// Parse [first, last) like int_reader: returns false if it stopped at something that is not a number
+bool parse_chunk(const char* first, const char* last, std::vector<int>& out)
+{
+    while (true) {
+        while (first < last && is_space(*first)) {
+            ++first;
+        }
+        if (first == last) {
+            return true;
+        }
+        if (*first == '+') {
+            ++first;
+        }
+        int x;
+        auto [ptr, ec] = std::from_chars(first, last, x);
+        if (ec != std::errc() || ptr == first) {
+            return false;
+        }
+        out.push_back(x);
+        first = ptr;
+    }
+}
+
+// The whole file is read in memory and split at whitespace, so no number is cut in two
+std::vector<int> parallel_read(std::istream& is, size_t nthreads)
+{
+    std::vector<char> text;
+    while (true) {
+        size_t n = text.size();
+        text.resize(n + (1 << 24));
+        is.read(text.data() + n, 1 << 24);
+        text.resize(n + is.gcount());
+        if (!is) {
+            break;
+        }
+    }
+
+    std::vector<size_t> bounds(nthreads + 1, text.size());
+    bounds[0] = 0;
+    for (size_t t = 1; t < nthreads; ++t) {
+        size_t b = std::max(bounds[t - 1], text.size() / nthreads * t);
+        while (b < text.size() && !is_space(text[b])) {
+            ++b;
+        }
+        bounds[t] = b;
+    }
+    std::vector<std::vector<int>> parts(nthreads);
+    std::vector<char> complete(nthreads);
+    parallel_for(nthreads, [&](size_t t) {
+        parts[t].reserve((bounds[t + 1] - bounds[t]) / 4);
+        complete[t] = parse_chunk(text.data() + bounds[t], text.data() + bounds[t + 1], parts[t]);
+    });
+
+    // Like int_reader, everything after the first invalid token is ignored
+    std::vector<size_t> offset(nthreads + 1, 0);
+    size_t used = 0;
+    while (used < nthreads) {
+        offset[used + 1] = offset[used] + parts[used].size();
+        if (!complete[used++]) {
+            break;
+        }
+    }
+    std::vector<int> numbers(offset[used]);
+    parallel_for(used, [&](size_t t) {
+        std::copy(begin(parts[t]), end(parts[t]), numbers.begin() + offset[t]);
+    });
+    return numbers;
+}
+
+// radix_sort with every pass split among the threads: each one counts the digits of its slice, the
+// counts of all the slices give each thread its own output position for every digit, and then all the
+// threads scatter at the same time. The order inside a digit stays the input one, as LSD needs.
+void parallel_radix_sort(int* v, size_t n, size_t nthreads)
+{
+    constexpr int bits = 11, passes = 3;
+    constexpr uint32_t radix = 1u << bits, mask = radix - 1;
+    if (nthreads < 2 || n < (size_t(1) << 16)) {
+        radix_sort(v, n);
+        return;
+    }
+    std::vector<int> tmp(n);
+    std::vector<std::vector<size_t>> count(nthreads, std::vector<size_t>(radix));
+    int* src = v;
+    int* dst = tmp.data();
+    size_t slice = (n + nthreads - 1) / nthreads;
+    for (int p = 0; p < passes; ++p) {
+        int shift = p * bits;
+        parallel_for(nthreads, [&](size_t t) {
+            auto& c = count[t];
+            std::fill(begin(c), end(c), 0);
+            for (size_t i = std::min(n, t * slice), end = std::min(n, (t + 1) * slice); i < end; ++i) {
+                ++c[((static_cast<uint32_t>(src[i]) ^ 0x80000000u) >> shift) & mask];
+            }
+        });
+        uint32_t first = ((static_cast<uint32_t>(src[0]) ^ 0x80000000u) >> shift) & mask;
+        size_t same = 0;
+        for (size_t t = 0; t < nthreads; ++t) {
+            same += count[t][first];
+        }
+        if (same == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (uint32_t d = 0; d < radix; ++d) {
+            for (size_t t = 0; t < nthreads; ++t) {
+                size_t x = count[t][d];
+                count[t][d] = sum;
+                sum += x;
+            }
+        }
+        parallel_for(nthreads, [&](size_t t) {
+            auto& c = count[t];
+            for (size_t i = std::min(n, t * slice), end = std::min(n, (t + 1) * slice); i < end; ++i) {
+                uint32_t key = static_cast<uint32_t>(src[i]) ^ 0x80000000u;
+                dst[c[(key >> shift) & mask]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != v) {
+        parallel_for(nthreads, [&](size_t t) {
+            size_t first = std::min(n, t * slice), last = std::min(n, (t + 1) * slice);
+            std::copy(src + first, src + last, v + first);
+        });
+    }
+}
+
+// Every thread formats a slice in its own buffer (at most 12 chars for each int), then they are
+// written in order
+void parallel_write(std::ostream& os, const std::vector<int>& numbers, size_t nthreads)
+{
+    size_t n = numbers.size();
+    size_t slice = (n + nthreads - 1) / nthreads;
+    std::vector<std::vector<char>> text(nthreads);
+    parallel_for(nthreads, [&](size_t t) {
+        size_t first = std::min(n, t * slice), last = std::min(n, (t + 1) * slice);
+        auto& out = text[t];
+        out.resize((last - first) * 12);
+        char* p = out.data();
+        for (size_t i = first; i < last; ++i) {
+            p = std::to_chars(p, p + 11, numbers[i]).ptr;
+            *p++ = '\n';
+        }
+        out.resize(p - out.data());
+    });
+    for (const auto& out : text) {
+        os.write(out.data(), out.size());
+    }
+}
+
+// ------------------------------ External sort (--mem) ------------------------------
+// For inputs larger than the memory: the input is read in runs that fit in the budget, each run is
+// sorted and spilled to a temporary binary file, and then all the runs are merged in a single pass.
+
+// Sorted run on disk, read one block at a time: the next block is read by another thread while the
+// current one is consumed (read-ahead)
+class run_reader {
+    std::ifstream is_;
+    std::vector<int> cur_, next_;
+    size_t pos_ = 0, size_ = 0;
+    std::future<size_t> pending_;
+
+    void start_read() {
+        pending_ = std::async(std::launch::async, [this] {
+            is_.read(reinterpret_cast<char*>(next_.data()), next_.size() * sizeof(int));
+            return static_cast<size_t>(is_.gcount()) / sizeof(int);
+        });
+    }
+
+public:
+    run_reader(const std::filesystem::path& name, size_t block)
+        : is_(name, std::ios::binary), cur_(block), next_(block) {
+        if (is_) {
+            start_read();
+        }
+    }
+
+    explicit operator bool() const { return static_cast<bool>(is_); }
+
+    bool next(int& x) {
+        if (pos_ == size_) {
+            size_ = pending_.get();
+            if (size_ == 0) {
+                return false;
+            }
+            std::swap(cur_, next_);
+            pos_ = 0;
+            start_read();
+        }
+        x = cur_[pos_++];
+        return true;
+    }
+};
+
+// Loser tree for the k-way merge: internal node i keeps the run that lost the match played there, and
+// node 0 the overall winner. After taking the winner, only the matches on the path from its leaf to
+// the root are replayed: log2(k) comparisons for each value, instead of 2 log2(k) with a heap.
+// Leaves are k..2k-1, so any k works. An exhausted run has a key larger than any int.
+class loser_tree {
+    size_t k_;
+    std::vector<size_t> tree_;
+    std::vector<int64_t> key_;
+
+public:
+    static constexpr int64_t exhausted = INT64_MAX;
+
+    loser_tree(const std::vector<int64_t>& keys) : k_(keys.size()), tree_(keys.size()), key_(keys) {
+        std::vector<size_t> winner(2 * k_);
+        for (size_t i = 0; i < k_; ++i) {
+            winner[k_ + i] = i;
+        }
+        for (size_t i = k_ - 1; i > 0; --i) {
+            size_t a = winner[2 * i], b = winner[2 * i + 1];
+            bool a_wins = key_[a] <= key_[b];
+            winner[i] = a_wins ? a : b;
+            tree_[i] = a_wins ? b : a;
+        }
+        tree_[0] = k_ > 1 ? winner[1] : 0;
+    }
+
+    size_t top() const { return tree_[0]; }
+    int64_t top_key() const { return key_[tree_[0]]; }
+
+    // The winner run has a new head (or is exhausted): replay its matches up to the root
+    void replace_top(int64_t key) {
+        size_t w = tree_[0];
+        key_[w] = key;
+        for (size_t node = (w + k_) / 2; node > 0; node /= 2) {
+            if (key_[tree_[node]] < key_[w]) {
+                std::swap(tree_[node], w);
+            }
+        }
+        tree_[0] = w;
+    }
+};
+
+// Text output, one int per line: a buffer is formatted while the previous one is written by another
+// thread (write-behind)
+class async_writer {
+    std::ostream& os_;
+    std::vector<char> buf_, out_;
+    size_t n_ = 0;
+    std::future<void> pending_;
+
+    void flush() {
+        if (pending_.valid()) {
+            pending_.get();
+        }
+        std::swap(buf_, out_);
+        pending_ = std::async(std::launch::async, [this, n = n_] { os_.write(out_.data(), n); });
+        n_ = 0;
+    }
+
+public:
+    async_writer(std::ostream& os, size_t size) : os_(os), buf_(size), out_(size) {}
+    ~async_writer() {
+        flush();
+        pending_.get();
+    }
+
+    void operator()(int x) {
+        if (buf_.size() - n_ < 12) {
+            flush();
+        }
+        char* p = std::to_chars(buf_.data() + n_, buf_.data() + buf_.size(), x).ptr;
+        *p++ = '\n';
+        n_ = p - buf_.data();
+    }
+};
+
+// Temporary run files, removed when the guard goes out of scope, on every exit path
+struct temp_files {
+    std::vector<std::filesystem::path> paths;
+
+    temp_files() = default;
+    temp_files(const temp_files&) = delete;
+    temp_files& operator=(const temp_files&) = delete;
+    ~temp_files() {
+        for (const auto& name : paths) {
+            std::error_code ec;
+            std::filesystem::remove(name, ec);
+        }
+    }
+};
+
+// The merge keeps every run open at once (one descriptor and one read-ahead thread each), so the
+// number of runs is capped below the usual descriptor limits (512 streams on Windows, 1024 fds on Linux).
+// The input may be at most max_runs * mem / 8 values: a larger one fails, asking for more --mem.
+constexpr size_t max_runs = 256;
+
+// mem is the budget in bytes. A run takes 8 bytes per value (the values and the radix_sort buffer);
+// in the merge, every run and the output get a double buffer from the same budget, but never less
+// than 4096 values each, so with many runs and a small --mem the merge may exceed it.
+bool external_sort(std::istream& is, std::ostream& os, const std::string& tmp_prefix, size_t mem)
+{
+    size_t run_size = std::max<size_t>(mem / (2 * sizeof(int)), 1024);
+    std::vector<int> run;
+    run.reserve(run_size);
+    temp_files guard;
+    auto& runs = guard.paths;
+    int_reader reader(is);
+    bool more = true;
+    while (more) {
+        run.clear();
+        int x;
+        while (run.size() < run_size && (more = reader(x))) {
+            run.push_back(x);
+        }
+        if (run.empty()) {
+            break;
+        }
+        radix_sort(run.data(), run.size());
+        if (runs.empty() && !more) {
+            // Everything fits in memory: no need to spill
+            async_writer writer(os, 1 << 20);
+            for (const auto& v : run) {
+                writer(v);
+            }
+            return true;
+        }
+        if (runs.size() == max_runs) {
+            std::println(std::cerr, "Error: the input needs more than {} runs, use a larger --mem", max_runs);
+            return false;
+        }
+        runs.emplace_back(tmp_prefix + ".run" + std::to_string(runs.size()));
+        std::ofstream spill(runs.back(), std::ios::binary);
+        if (!spill.write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(int))) {
+            std::println(std::cerr, "Error writing {}", runs.back().string());
+            return false;
+        }
+    }
+    run = std::vector<int>();   // give the memory back before the merge
+
+    if (!runs.empty()) {
+        size_t block = std::max<size_t>(mem / (2 * (runs.size() + 1) * sizeof(int)), 4096);
+        std::vector<std::unique_ptr<run_reader>> readers;
+        std::vector<int64_t> keys;
+        for (const auto& name : runs) {
+            readers.push_back(std::make_unique<run_reader>(name, block));
+            if (!*readers.back()) {
+                std::println(std::cerr, "Error opening {}", name.string());
+                return false;
+            }
+            int x;
+            keys.push_back(readers.back()->next(x) ? x : loser_tree::exhausted);
+        }
+        loser_tree tree(keys);
+        async_writer writer(os, block * sizeof(int));
+        while (tree.top_key() != loser_tree::exhausted) {
+            writer(static_cast<int>(tree.top_key()));
+            int x;
+            tree.replace_top(readers[tree.top()]->next(x) ? x : loser_tree::exhausted);
+        }
+    }
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     {
-        if (argc != 3) {
+        bool decode = argc == 4 && std::string(argv[1]) == "--decode";
+        bool benchmark = argc == 3 && std::string(argv[1]) == "--bench";
+        bool binary = false, radix = false, usage = argc < 3;
+        bool unique = false, count = false;
+        size_t nthreads = 0, mem_mib = 0, top = 0;
+        for (int i = 3; i < argc && !decode; ++i) {
+            std::string opt = argv[i];
+            if (opt == "--binary") {
+                binary = true;
+            }
+            else if (opt == "--radix") {
+                radix = true;
+            }
+            else if (opt == "--unique") {
+                unique = true;
+            }
+            else if (opt == "--count") {
+                count = true;
+            }
+            else if (opt == "--top" && i + 1 < argc) {
+                std::string_view arg = argv[++i];
+                if (std::from_chars(arg.data(), arg.data() + arg.size(), top).ec != std::errc() || top == 0) {
+                    usage = true;
+                }
+            }
+            else if (opt == "--mem" && i + 1 < argc) {
+                std::string_view arg = argv[++i];
+                if (std::from_chars(arg.data(), arg.data() + arg.size(), mem_mib).ec != std::errc() || mem_mib == 0) {
+                    usage = true;
+                }
+            }
+            else if (opt == "--threads" && i + 1 < argc) {
+                std::string_view arg = argv[++i];
+                if (std::from_chars(arg.data(), arg.data() + arg.size(), nthreads).ec != std::errc()) {
+                    usage = true;
+                }
+                else if (nthreads == 0) {
+                    nthreads = std::max(1u, std::thread::hardware_concurrency());
+                }
+            }
+            else {
+                usage = true;
+            }
+        }
+        if (usage) {
             //std::cerr << "Usage: sort_int <filein.txt> <fileout.txt>\n";
             // or better
             //std::format("Usage: {} <filein.txt> <fileout.txt>\n", argv[0]);  // not working on default c++17, fix needed!!!
             // or
-            std::println("Usage: {} <filein.txt> <fileout.txt>", argv[0]);   // not working on default c++17, fix needed!!!
+            std::println("Usage: {} <filein.txt> <fileout.txt> [--binary] [--radix] [--threads <N>]", argv[0]);   // not working on default c++17, fix needed!!!
+            std::println("       {} <filein.txt> <fileout.txt> --mem <MiB>", argv[0]);
+            std::println("       {} <filein.txt> <fileout.txt> [--top <K> | --unique | --count] [--binary] [--radix]", argv[0]);
+            std::println("       {} --decode <filein.bin> <fileout.txt>", argv[0]);
+            std::println("       {} --bench <N>", argv[0]);
+            return 1;
+        }
+        if (mem_mib > 0 && (binary || nthreads > 0)) {
+            std::println(std::cerr, "--mem cannot be used with --binary or --threads");
             return 1;
         }
+        if ((top > 0) + unique + count > 1 || ((top > 0 || unique || count) && (mem_mib > 0 || nthreads > 0))) {
+            std::println(std::cerr, "Only one of --top, --unique and --count, and not with --mem or --threads");
+            return 1;
+        }
+        if (count && binary) {
+            std::println(std::cerr, "--count writes text only");
+            return 1;
+        }
+        if (benchmark) {
+            size_t n = 0;
+            std::string_view arg = argv[2];
+            if (std::from_chars(arg.data(), arg.data() + arg.size(), n).ec != std::errc() || n == 0) {
+                std::println(std::cerr, "Invalid number of values: {}", argv[2]);
+                return 1;
+            }
+            bench(n);
+            return 0;
+        }
+        if (decode) {
+            // Back from the binary output of --binary to text
+            std::ifstream filein(argv[2], std::ios::binary);
+            if (filein.fail()) {
+                std::println(std::cerr, "Error opening {}", argv[2]);
+                return 1;
+            }
+            std::vector<int> numbers;
+            if (!read_svb(filein, numbers)) {
+                std::println(std::cerr, "{} is not a valid --binary file", argv[2]);
+                return 1;
+            }
+            std::ofstream fileout(argv[3]);
+            if (fileout.fail()) {
+                std::cerr << "Error opening output file";
+                return 1;
+            }
+            std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(fileout, "\n"));
+            return 0;
+        }
 
         // std::ifstream input(argv[1], std::ios::binary);  // to explicitly specify the mode to binary, default is text mode
 
@@ -66,13 +761,99 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        std::ofstream fileout(argv[2]);
+        std::ofstream fileout(argv[2], binary ? std::ios::binary : std::ios::out);
         if (fileout.fail()) {
             std::cerr << "Error opening output file";
             // filein.close();  // No necessary anymore with the destructor in place
             return 1;
         }
 
+        if (mem_mib > 0) {
+            // External sort: the temporary runs are written next to the output file
+            return external_sort(filein, fileout, argv[2], mem_mib << 20) ? 0 : 1;
+        }
+
+        if (top > 0) {
+            // The first K values of the sorted output, in one streaming pass: a max-heap keeps the K smallest
+            // seen so far, and a new value replaces the largest of them only if it is smaller. O(n log K)
+            // time and O(K) memory, whatever the size of the input.
+            std::priority_queue<int> heap;
+            int_reader reader(filein);
+            for (int x; reader(x);) {
+                if (heap.size() < top) {
+                    heap.push(x);
+                }
+                else if (x < heap.top()) {
+                    heap.pop();
+                    heap.push(x);
+                }
+            }
+            std::vector<int> numbers(heap.size());
+            for (auto it = numbers.rbegin(); it != numbers.rend(); ++it) {
+                *it = heap.top();
+                heap.pop();
+            }
+            if (binary) {
+                write_svb(fileout, numbers.data(), numbers.size());
+            }
+            else {
+                std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(fileout, "\n"));
+            }
+            return 0;
+        }
+        if (unique || count) {
+            // Sorting puts equal values next to each other: --unique removes the repeated ones in place
+            // (what std::set would give), --count writes each value with the size of its run (std::multiset)
+            std::vector<int> numbers = read(filein);
+            const char* strategy;
+            if (counting_sort(numbers.data(), numbers.size())) {
+                strategy = "counting sort";
+            }
+            else if (radix) {
+                radix_sort(numbers.data(), numbers.size());
+                strategy = "radix sort";
+            }
+            else {
+                std::ranges::sort(numbers);
+                strategy = "std::sort";
+            }
+            std::println(std::cerr, "Sorted {} values with {}", numbers.size(), strategy);
+            if (unique) {
+                numbers.erase(std::unique(begin(numbers), end(numbers)), end(numbers));
+                if (binary) {
+                    write_svb(fileout, numbers.data(), numbers.size());
+                }
+                else {
+                    std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(fileout, "\n"));
+                }
+            }
+            else {
+                for (size_t i = 0; i < numbers.size();) {
+                    size_t j = i + 1;
+                    while (j < numbers.size() && numbers[j] == numbers[i]) {
+                        ++j;
+                    }
+                    fileout << numbers[i] << ' ' << j - i << '\n';
+                    i = j;
+                }
+            }
+            return 0;
+        }
+
+        if (nthreads > 0) {
+            // Parallel mode, 0 threads means one for each core. The sort is always the radix one, and the
+            // numbers are not echoed on the console (there may be billions of them).
+            std::vector<int> numbers = parallel_read(filein, nthreads);
+            parallel_radix_sort(numbers.data(), numbers.size(), nthreads);
+            if (binary) {
+                write_svb(fileout, numbers.data(), numbers.size());
+            }
+            else {
+                parallel_write(fileout, numbers, nthreads);
+            }
+            return 0;
+        }
+
         //std::vector<int> numbers = read(filein);
 
         // Let's change this to c++ without a read function
@@ -89,15 +870,34 @@ int main(int argc, char* argv[]) {
         //std::vector<int> numbers(start, stop);
 
         // or way better
-        std::vector<int> numbers{std::istream_iterator<int>(filein), std::istream_iterator<int>()};
+        //std::vector<int> numbers{std::istream_iterator<int>(filein), std::istream_iterator<int>()};
+
+        // or way faster, skipping operator>> altogether
+        std::vector<int> numbers;
+        int_reader reader(filein);
+        for (int x; reader(x);) {
+            numbers.push_back(x);
+        }
         //std::sort(numbers.begin(), numbers.end(), rev_comparator());
 
         // both can be replaced with
         //std::set<int> numbers{std::istream_iterator<int>(filein), std::istream_iterator<int>()};
         //std::multiset<int> numbers{std::istream_iterator<int>(filein), std::istream_iterator<int>()}; // to keep multiple elements that are the same      
 
-        using namespace std::ranges;  // not working on default c++17, fix needed!!!
-        sort(numbers);                // not working on default c++17, fix needed!!!
+        const char* strategy;
+        if (counting_sort(numbers.data(), numbers.size())) {
+            strategy = "counting sort";
+        }
+        else if (radix) {
+            radix_sort(numbers.data(), numbers.size());
+            strategy = "radix sort";
+        }
+        else {
+            using namespace std::ranges;  // not working on default c++17, fix needed!!!
+            sort(numbers);                // not working on default c++17, fix needed!!!
+            strategy = "std::sort";
+        }
+        std::println(std::cerr, "Sorted {} values with {}", numbers.size(), strategy);
 
         // print(numbers, fileout);
         // print(numbers, std::cout);
@@ -106,7 +906,12 @@ int main(int argc, char* argv[]) {
         //    std::cout << x << " , ";
         //}
         // Becames
-        std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(fileout, "\n")); // From the iterator library
+        if (binary) {
+            write_svb(fileout, numbers.data(), numbers.size());
+        }
+        else {
+            std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(fileout, "\n")); // From the iterator library
+        }
         std::copy(begin(numbers), end(numbers), std::ostream_iterator<int>(std::cout, ", ")); // From the iterator library
         
     }
@@ -2,17 +2,155 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
 
 #define MAX_NUMBERS 10000
 #define MAX_CHARS 100
 
+/* The numbers array starts with room for MAX_NUMBERS and doubles when it is full: a fixed array on the
+   stack was silently overflowed by larger inputs */
+void push_number(int **numbers, int *count, int *capacity, int x) {
+    if (*count == *capacity) {
+        int *tmp = realloc(*numbers, (size_t)*capacity * 2 * sizeof(int));
+        if (!tmp) {
+            perror("Memory allocation error");
+            exit(1);
+        }
+        *numbers = tmp;
+        *capacity *= 2;
+    }
+    (*numbers)[(*count)++] = x;
+}
+
+/* Comparing instead of subtracting: a - b overflows when the values are far apart */
 int compare_ints(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* Counting sort, used automatically when the range of the values is not wider than their number: one
+   pass to count each value, one to write them back in order. Returns 0, leaving v alone, otherwise. */
+int counting_sort(int *v, int n) {
+    if (n < 2) {
+        return 0;
+    }
+    int min = v[0], max = v[0];
+    for (int i = 1; i < n; i++) {
+        min = v[i] < min ? v[i] : min;
+        max = v[i] > max ? v[i] : max;
+    }
+    int64_t range = (int64_t)max - min + 1;
+    if (range > n) {
+        return 0;
+    }
+    int *count = calloc((size_t)range, sizeof(int));
+    if (!count) {
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        count[(int64_t)v[i] - min]++;
+    }
+    int k = 0;
+    for (int64_t d = 0; d < range; d++) {
+        for (int c = 0; c < count[d]; c++) {
+            v[k++] = (int)(min + d);
+        }
+    }
+    free(count);
+    return 1;
+}
+
+/* LSD radix sort on 11-bit digits (3 passes), with the sign bit flipped so that signed keys sort as
+   unsigned ones. Passes where every key has the same digit are skipped. */
+void radix_sort(int *v, int n) {
+    enum { BITS = 11, PASSES = 3, RADIX = 1 << BITS };
+    static size_t count[PASSES][RADIX];
+    if (n < 2) {
+        return;
+    }
+    int *tmp = malloc((size_t)n * sizeof(int));
+    if (!tmp) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    memset(count, 0, sizeof(count));
+    for (int i = 0; i < n; i++) {
+        uint32_t key = (uint32_t)v[i] ^ 0x80000000u;
+        for (int p = 0; p < PASSES; p++) {
+            count[p][(key >> (p * BITS)) & (RADIX - 1)]++;
+        }
+    }
+    int *src = v, *dst = tmp;
+    for (int p = 0; p < PASSES; p++) {
+        uint32_t first = (((uint32_t)src[0] ^ 0x80000000u) >> (p * BITS)) & (RADIX - 1);
+        if (count[p][first] == (size_t)n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (int d = 0; d < RADIX; d++) {
+            size_t x = count[p][d];
+            count[p][d] = sum;
+            sum += x;
+        }
+        for (int i = 0; i < n; i++) {
+            uint32_t key = (uint32_t)src[i] ^ 0x80000000u;
+            dst[count[p][(key >> (p * BITS)) & (RADIX - 1)]++] = src[i];
+        }
+        int *t = src;
+        src = dst;
+        dst = t;
+    }
+    if (src != v) {
+        memcpy(v, src, (size_t)n * sizeof(int));
+    }
+    free(tmp);
+}
+
+/* Binary output: differences between consecutive values, zigzag mapped, as Stream VByte varints.
+   "SVBDELTA", the count (32 bit LE), 1 control byte every 4 values (2 bits each, length - 1, from the
+   least significant) and then 1 to 4 little endian bytes for each value. sort_io --decode reads it. */
+void write_svb(FILE *f, const int *v, int n) {
+    unsigned char *control = calloc((n + 3) / 4 + 1, 1);
+    unsigned char *data = malloc((size_t)n * 4 + 1);
+    if (!control || !data) {
+        perror("Memory allocation error");
+        exit(1);
+    }
+    size_t size = 0;
+    uint32_t prev = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t delta = (uint32_t)v[i] - prev;
+        prev = (uint32_t)v[i];
+        uint32_t zz = (delta << 1) ^ (0u - (delta >> 31));
+        int len = 1 + (zz > 0xff) + (zz > 0xffff) + (zz > 0xffffff);
+        control[i / 4] |= (unsigned char)((len - 1) << (2 * (i % 4)));
+        for (int b = 0; b < len; b++) {
+            data[size++] = (unsigned char)(zz >> (8 * b));
+        }
+    }
+    fwrite("SVBDELTA", 1, 8, f);
+    for (int i = 0; i < 32; i += 8) {
+        fputc((int)(((uint32_t)n >> i) & 0xff), f);
+    }
+    fwrite(control, 1, (n + 3) / 4, f);
+    fwrite(data, 1, size, f);
+    free(control);
+    free(data);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: sort_int <filein.txt> <fileout.txt>\n");
+    int binary = 0, radix = 0, usage = argc < 3;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--binary") == 0) {
+            binary = 1;
+        } else if (strcmp(argv[i], "--radix") == 0) {
+            radix = 1;
+        } else {
+            usage = 1;
+        }
+    }
+    if (usage) {
+        fprintf(stderr, "Usage: sort_int <filein.txt> <fileout.txt> [--binary] [--radix]\n");
         return 1;
     }
 
@@ -22,7 +160,12 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    int numbers[MAX_NUMBERS];
+    int capacity = MAX_NUMBERS;
+    int *numbers = malloc(capacity * sizeof(int));
+    if (!numbers) {
+        perror("Memory allocation error");
+        return 1;
+    }
     char str[MAX_CHARS];
     int count = 0;
 
@@ -32,14 +175,16 @@ int main(int argc, char *argv[]) {
     {
         if (isdigit(ch) || ch == '-')
         {
-            str[i++] = ch;
+            if (i < MAX_CHARS - 1) {
+                str[i++] = ch;
+            }
         }
         else if (isspace(ch) || ch == '\n')
         {
             if (i>0)
             {
                 str[i] = '\0';
-                numbers[count++] = atoi(str);
+                push_number(&numbers, &count, &capacity, atoi(str));
                 i=0;
             }
         }else
@@ -47,7 +192,7 @@ int main(int argc, char *argv[]) {
             if (i>0)
             {
                 str[i] = '\0';
-                numbers[count++] = atoi(str);
+                push_number(&numbers, &count, &capacity, atoi(str));
                 i=0;
             }
             break;
@@ -56,20 +201,35 @@ int main(int argc, char *argv[]) {
 
     fclose(filein);
 
-    qsort(numbers, count, sizeof(int), compare_ints);
+    const char *strategy;
+    if (counting_sort(numbers, count)) {
+        strategy = "counting sort";
+    } else if (radix) {
+        radix_sort(numbers, count);
+        strategy = "radix sort";
+    } else {
+        qsort(numbers, count, sizeof(int), compare_ints);
+        strategy = "qsort";
+    }
+    fprintf(stderr, "Sorted %d values with %s\n", count, strategy);
 
-    FILE *fileout = fopen(argv[2], "w");
+    FILE *fileout = fopen(argv[2], binary ? "wb" : "w");
     if (!fileout) {
         perror("Error opening output file");
         fclose(filein);
         return 1;
     }
 
-    for (int i = 0; i < count; i++) {
-        fprintf(fileout, "%d\n", numbers[i]);
+    if (binary) {
+        write_svb(fileout, numbers, count);
+    } else {
+        for (int i = 0; i < count; i++) {
+            fprintf(fileout, "%d\n", numbers[i]);
+        }
     }
 
     fclose(fileout);
+    free(numbers);
 
     return 0;
 }
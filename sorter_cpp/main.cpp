@@ -3,7 +3,15 @@
 #include <cstdlib>  // for std::malloc and std::realloc
 #include <cstdio>   // for perror
 #include <cassert>  // for assert
+#include <utility>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <crtdbg.h>
+#include "int_io.h"
 
 class vector {
 public:
@@ -105,7 +113,72 @@ public:
 };
 
 int compare_ints(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Used instead of radix_sort when the range is not wider than n; 32 bit counters (n < 2^32)
+bool counting_sort(int* v, size_t n)
+{
+    if (n < 2 || n > UINT32_MAX) {
+        return false;
+    }
+    auto [lo, hi] = std::minmax_element(v, v + n);
+    int64_t min = *lo;
+    uint64_t range = static_cast<uint64_t>(int64_t(*hi) - min) + 1;
+    if (range > n) {
+        return false;
+    }
+    std::vector<uint32_t> count(range, 0);
+    for (size_t i = 0; i < n; ++i) {
+        ++count[v[i] - min];
+    }
+    int* out = v;
+    for (uint64_t d = 0; d < range; ++d) {
+        out = std::fill_n(out, count[d], static_cast<int>(min + static_cast<int64_t>(d)));
+    }
+    return true;
+}
+
+// LSD radix sort, 11-bit digits with the sign bit flipped; passes that would not move anything are skipped
+void radix_sort(int* v, size_t n)
+{
+    constexpr int bits = 11, passes = 3;
+    constexpr uint32_t radix = 1u << bits, mask = radix - 1;
+    if (n < 2) {
+        return;
+    }
+    std::vector<size_t> count(passes * radix, 0);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t key = static_cast<uint32_t>(v[i]) ^ 0x80000000u;
+        for (int p = 0; p < passes; ++p) {
+            ++count[p * radix + ((key >> (p * bits)) & mask)];
+        }
+    }
+    std::vector<int> tmp(n);
+    int* src = v;
+    int* dst = tmp.data();
+    for (int p = 0; p < passes; ++p) {
+        size_t* c = &count[p * radix];
+        uint32_t first = ((static_cast<uint32_t>(src[0]) ^ 0x80000000u) >> (p * bits)) & mask;
+        if (c[first] == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (uint32_t d = 0; d < radix; ++d) {
+            size_t x = c[d];
+            c[d] = sum;
+            sum += x;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t key = static_cast<uint32_t>(src[i]) ^ 0x80000000u;
+            dst[c[(key >> (p * bits)) & mask]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != v) {
+        std::memcpy(v, src, n * sizeof(int));
+    }
 }
 
 void print(const vector& v, std::ostream& os) {
@@ -114,10 +187,48 @@ void print(const vector& v, std::ostream& os) {
     }
 }
 
+// --binary: "SVBDELTA", a 32 bit LE count, then the zigzag deltas as Stream VByte (control bytes, data)
+void write_svb(std::ostream& os, const int* v, size_t n)
+{
+    std::vector<uint8_t> control((n + 3) / 4, 0);
+    std::vector<uint8_t> data;
+    data.reserve(n * 4);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t delta = static_cast<uint32_t>(v[i]) - prev;
+        prev = static_cast<uint32_t>(v[i]);
+        uint32_t zz = (delta << 1) ^ (0u - (delta >> 31));
+        uint32_t len = 1 + (zz > 0xff) + (zz > 0xffff) + (zz > 0xffffff);
+        control[i / 4] |= static_cast<uint8_t>((len - 1) << (2 * (i % 4)));
+        for (uint32_t b = 0; b < len; ++b) {
+            data.push_back(static_cast<uint8_t>(zz >> (8 * b)));
+        }
+    }
+    os.write("SVBDELTA", 8);
+    for (int i = 0; i < 32; i += 8) {
+        os.put(static_cast<char>(n >> i));
+    }
+    os.write(reinterpret_cast<const char*>(control.data()), control.size());
+    os.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
 int main(int argc, char* argv[]) {
     {
-        if (argc != 3) {
-            std::cerr << "Usage: sort_int <filein.txt> <fileout.txt>\n";
+        bool binary = false, radix = false, usage = argc < 3;
+        for (int i = 3; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "--binary") {
+                binary = true;
+            }
+            else if (opt == "--radix") {
+                radix = true;
+            }
+            else {
+                usage = true;
+            }
+        }
+        if (usage) {
+            std::cerr << "Usage: sort_int <filein.txt> <fileout.txt> [--binary] [--radix]\n";
             return 1;
         }
 
@@ -127,7 +238,7 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        std::ofstream fileout(argv[2]);
+        std::ofstream fileout(argv[2], binary ? std::ios::binary : std::ios::out);
         if (!fileout.is_open()) {
             perror("Error opening output file");
             filein.close();
@@ -136,7 +247,8 @@ int main(int argc, char* argv[]) {
 
         vector numbers;
         int num;
-        while (filein >> num) {
+        int_reader reader(filein);
+        while (reader(num)) {
             numbers.push_back(num);
         }
 
@@ -146,9 +258,26 @@ int main(int argc, char* argv[]) {
         vector copy;
         copy = original = numbers;
 
-        std::qsort(numbers.data_, numbers.size(), sizeof(int), compare_ints);
+        const char* strategy;
+        if (counting_sort(numbers.data_, numbers.size())) {
+            strategy = "counting sort";
+        }
+        else if (radix) {
+            radix_sort(numbers.data_, numbers.size());
+            strategy = "radix sort";
+        }
+        else {
+            std::qsort(numbers.data_, numbers.size(), sizeof(int), compare_ints);
+            strategy = "qsort";
+        }
+        std::cerr << "Sorted " << numbers.size() << " values with " << strategy << "\n";
 
-        print(numbers, fileout);
+        if (binary) {
+            write_svb(fileout, numbers.data_, numbers.size());
+        }
+        else {
+            print(numbers, fileout);
+        }
 
         filein.close();
         fileout.close();
@@ -60,7 +60,8 @@ int vector_at(struct vector const *this, size_t index)
 
 
 int compare_ints(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
 }
 
 int main(int argc, char *argv[]) {
@@ -2,138 +2,272 @@
 #include <fstream>
 #include <cstdlib>  // for std::malloc and std::realloc
 #include <cstdio>   // for perror
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <cassert>  // for assert
 #include <chrono>
 #include <crtdbg.h>
 #include <utility>
+#include <algorithm>
+#include <new>
+#include <ratio>
+#include <type_traits>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>  // for abi::__cxa_demangle
+#endif
+#include <deque>
 #include <vector>
+#include <string>
+#include <string_view>
+#include "int_io.h"
 // Or just use std::vector
 //#include <vector>
 
 namespace mdp
 {
-    template<typename T>
-    class vector {
+    // Instrumentation: build with MDP_INSTRUMENT defined (-DMDP_INSTRUMENT or /DMDP_INSTRUMENT) to count,
+    // for every container type, allocations, allocated bytes, reallocations, copies and moves of the
+    // container and of its elements. A summary is written on stderr at exit, the normal output does not
+    // change. Without MDP_INSTRUMENT every hook is discarded by if constexpr and nothing is left in the
+    // code, so it replaces the prints that used to be in the constructors. Only mdp::vector and widget
+    // are counted: the std::vector scratch buffers (radix_sort, write_svb, --key, --bench) are not.
+#ifdef MDP_INSTRUMENT
+    inline constexpr bool instrumented = true;
+#else
+    inline constexpr bool instrumented = false;
+#endif
+
+    struct stats {
+        std::string name;
+        size_t allocations = 0, bytes = 0, reallocations = 0;
+        size_t copies = 0, moves = 0, element_copies = 0, element_moves = 0, destroys = 0;
+    };
+
+    class stats_registry {
+        std::deque<stats> all_;     // a deque never moves its elements, so stats_of can keep references
+
     public:
-        size_t size_, capacity_;
-        T* data_;
-
-        // Default constructor
-        vector() : size_(0), capacity_(1), data_(nullptr)
-        {
-            std::cout << "Creating vector" << std::endl;    // For debug purpose
-
-            data_ = new T[capacity_];
-            //data_ = (T*)malloc(capacity_ * sizeof(T));
-            //if (data_ == nullptr) {
-            //    perror("Constructor memory allocation error!");
-            //    exit(EXIT_FAILURE); // EXIT_FAILURE == 1
-            //}
-        }
-        // Copy constructor
-        vector(const vector& other)
-        {
-            std::cout << "Copy constructor" << std::endl;   // For debug purpose
-
-            size_ = other.size_;
-            capacity_ = other.capacity_;
-            data_ = new T[capacity_];
-            //data_ = (T*)malloc(capacity_ * sizeof(T));
-            //if (data_ == nullptr) {
-            //    perror("Copy memory allocation error!");
-            //    exit(EXIT_FAILURE); // EXIT_FAILURE == 1
-            //}
-            for (size_t i = 0; i < size_; ++i) {
-                data_[i] = other.data_[i];
+        static stats_registry& get() {
+            static stats_registry registry;
+            return registry;
+        }
+
+        stats& add(std::string name) {
+            all_.emplace_back().name = std::move(name);
+            return all_.back();
+        }
+
+        ~stats_registry() {
+            std::cerr << "--- mdp instrumentation ---\n";
+            for (const auto& s : all_) {
+                std::cerr << s.name << ":";
+                auto field = [](const char* label, size_t value) {
+                    if (value > 0) {
+                        std::cerr << " " << label << " " << value;
+                    }
+                };
+                field("allocations", s.allocations);
+                field("bytes", s.bytes);
+                field("reallocations", s.reallocations);
+                field("copies", s.copies);
+                field("moves", s.moves);
+                field("element copies", s.element_copies);
+                field("element moves", s.element_moves);
+                field("destroys", s.destroys);
+                std::cerr << "\n";
             }
         }
-        // Move constructor
-        vector(vector&& other)  //rvalue reference
-        {
-            std::cout << "Move constructor" << std::endl;
-
-            size_ = other.size_;
-            capacity_ = other.capacity_;
-            data_ = other.data_;
-            other.data_ = nullptr;
-            other.capacity_ = 0;
-        }
-        // void as return would not allow  something like other = original = numbers    -   called copy assignment
-        vector& operator=(const vector& other)  // Now I want to covert it to the = operator
-        {
-            std::cout << "Copy assignment" << std::endl;    // For debug purpose
-
-            if (this == &other){return *this;}
-            if (other.size_ > capacity_)
-            {
-                free(data_);    // pay attention to self assaignment numbers = numbers
-                capacity_ = other.capacity_;
-                data_ = new T[capacity_];
-                //data_ = (T*)malloc(capacity_ * sizeof(T));
-                //if (data_ == nullptr)
-                //{
-                //    perror("Operator= memory allocation error!");
-                //    exit(EXIT_FAILURE); // EXIT_FAILURE == 1
-                //}
+    };
+
+    // Readable name of T: GCC and Clang give the mangled one ("N3mdp6vectorIiSt5ratioILl2ELl1EEEE"),
+    // MSVC an already readable one
+    template<typename T>
+    std::string type_name() {
+        const char* name = typeid(T).name();
+#ifdef __GNUG__
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        std::string result = status == 0 ? demangled : name;
+        std::free(demangled);
+        return result;
+#else
+        return name;
+#endif
+    }
+
+    // Counters of type T, registered on first use. They are per type, not per object: every
+    // mdp::vector<int> in the program (numbers in main, all the vectors of --bench) adds to the same line.
+    template<typename T>
+    stats& stats_of() {
+        static stats& s = stats_registry::get().add(type_name<T>());
+        return s;
+    }
+
+    // Types that can be moved to a new address with a plain memcpy of their bytes (and no destructor call
+    // on the old copy). True for trivially copyable types; specialize it for types that own memory
+    // through a pointer (for example a unique_ptr-like handle) to get the same fast growth.
+    template<typename T>
+    struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+    template<typename T>
+    constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+    // The memory always comes from malloc/realloc and goes back with free, the elements are built in it
+    // with placement new: the old new T[]/free pair was undefined behaviour. When the vector is full,
+    // the capacity grows by Growth (2 by default, std::ratio<3, 2> for 1.5). Trivially relocatable
+    // elements grow with realloc, which can often extend the block in place and otherwise copies it
+    // with memcpy; the others are moved (or copied, if their move can throw) one by one.
+    template<typename T, typename Growth = std::ratio<2>>
+    class vector {
+        static_assert(Growth::num > Growth::den, "the growth factor must be greater than 1");
+
+        size_t size_ = 0, capacity_ = 0;
+        T* data_ = nullptr;
+
+        void reallocate(size_t capacity) {
+            if constexpr (instrumented) {
+                stats& s = stats_of<vector>();
+                ++s.allocations;
+                s.bytes += capacity * sizeof(T);
+                if (size_ > 0) {
+                    ++s.reallocations;
+                    if constexpr (!is_trivially_relocatable_v<T>) {
+                        (std::is_nothrow_move_constructible_v<T> ? s.element_moves : s.element_copies) += size_;
+                    }
+                }
             }
-            size_ = other.size_;
-            for (size_t i = 0; i < size_; ++i)
-            {
-                data_[i] = other.data_[i];
+            if constexpr (is_trivially_relocatable_v<T>) {
+                T* tmp = static_cast<T*>(std::realloc(data_, capacity * sizeof(T)));
+                if (tmp == nullptr) {
+                    throw std::bad_alloc();
+                }
+                data_ = tmp;
             }
-            return *this;
+            else {
+                T* tmp = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+                if (tmp == nullptr) {
+                    throw std::bad_alloc();
+                }
+                // Build every element in tmp before touching the old ones: if a copy throws, the built
+                // ones are destroyed, tmp is freed and the vector is left as it was
+                size_t built = 0;
+                try {
+                    for (; built < size_; ++built) {
+                        new (tmp + built) T(std::move_if_noexcept(data_[built]));
+                    }
+                }
+                catch (...) {
+                    for (size_t i = 0; i < built; ++i) {
+                        tmp[i].~T();
+                    }
+                    std::free(tmp);
+                    throw;
+                }
+                for (size_t i = 0; i < size_; ++i) {
+                    data_[i].~T();
+                }
+                std::free(data_);
+                data_ = tmp;
+            }
+            capacity_ = capacity;
         }
-        // move assignment
-        vector& operator=(vector&& other)  // Now I want to covert it to the = operator
-        {
-            std::cout << "Move assignment" << std::endl;    // For debug purpose
 
-            if (this != &other)
-            {
-                //free(data_);  // Instead of freeing our data, we can save it and put to other to be destroyed anyway
-                capacity_ = other.capacity_;
+        void grow() {
+            size_t capacity = capacity_ * Growth::num / Growth::den;
+            reserve(std::max(capacity, capacity_ + 1));
+        }
+
+    public:
+        vector() = default;
+
+        vector(const vector& other) {
+            if constexpr (instrumented) {
+                ++stats_of<vector>().copies;
+                stats_of<vector>().element_copies += other.size_;
+            }
+            reserve(other.size_);
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                if (other.size_ > 0) {
+                    std::memcpy(data_, other.data_, other.size_ * sizeof(T));
+                }
                 size_ = other.size_;
-                //int* tmp_data = other.data_;
-                //data_ = other.data_;
-                //other.data_ = tmp_data;
-                std::swap(data_, other.data_);  // Even better!
             }
+            else {
+                for (size_t i = 0; i < other.size_; ++i) {
+                    emplace_back(other.data_[i]);
+                }
+            }
+        }
+
+        vector(vector&& other) noexcept
+            : size_(std::exchange(other.size_, 0)), capacity_(std::exchange(other.capacity_, 0)),
+              data_(std::exchange(other.data_, nullptr)) {
+            if constexpr (instrumented) {
+                ++stats_of<vector>().moves;
+            }
+        }
+
+        // Copy and swap: a single operator= for copy and move assignment, and safe on self assignment
+        vector& operator=(vector other) noexcept {
+            std::swap(size_, other.size_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(data_, other.data_);
             return *this;
         }
-        // Destructor
+
         ~vector() {
-            std::cout << "Destroying vector" << std::endl;  // For debug purpose
+            clear();
+            std::free(data_);
+        }
 
-            free(data_);
+        void reserve(size_t capacity) {
+            if (capacity > capacity_) {
+                reallocate(capacity);
+            }
         }
 
-        void push_back(const T& x) {
+        template<typename... Args>
+        T& emplace_back(Args&&... args) {
             if (size_ == capacity_) {
-                capacity_ *= 2;
+                // args may refer to an element of this vector: build the new one before moving them
+                T tmp(std::forward<Args>(args)...);
+                grow();
+                return *new (data_ + size_++) T(std::move(tmp));
+            }
+            return *new (data_ + size_++) T(std::forward<Args>(args)...);
+        }
 
-                // Allocate new memory, copy old data in new memory, delete old memory.
-                T* tmp = new T[capacity_];
-                for (size_t i =0; i < size_; ++i)
-                {
-                    tmp[i] = data_[i];
-                }
-                delete[] data_;
-                data_ = tmp;
+        void push_back(const T& x) { emplace_back(x); }
+        void push_back(T&& x) { emplace_back(std::move(x)); }
 
-                //T* new_data = (T*)realloc(data_, capacity_ * sizeof(T));
-                //if (new_data == nullptr) {
-                //    perror("PushBack memory allocation error!");
-                //    exit(EXIT_FAILURE);
-                //}
-                //data_ = new_data;
-            }
-            data_[size_] = x;
-            size_++;
+        void pop_back() {
+            assert(size_ > 0);
+            data_[--size_].~T();
         }
 
-        size_t size() const {
-            return size_;
+        void clear() {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                for (size_t i = 0; i < size_; ++i) {
+                    data_[i].~T();
+                }
+            }
+            size_ = 0;
         }
+
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+        bool empty() const { return size_ == 0; }
+
+        T* data() { return data_; }
+        const T* data() const { return data_; }
+
+        T* begin() { return data_; }
+        T* end() { return data_ + size_; }
+        const T* begin() const { return data_; }
+        const T* end() const { return data_ + size_; }
+
         // Before was: const T& at(size_t index) const{...
         const T& operator[](size_t index) const {
             assert(index < size_); // Works only in debug mode, in release mode will be ignored
@@ -147,11 +281,77 @@ namespace mdp
     };
 }
 
+
 // Kinda pointles using namespace at file level
 //using namespace mdp;
 
 int compare_ints(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Histogram sort, tried first: only when max - min < n, 32 bit counters (n < 2^32)
+bool counting_sort(int* v, size_t n)
+{
+    if (n < 2 || n > UINT32_MAX) {
+        return false;
+    }
+    auto [lo, hi] = std::minmax_element(v, v + n);
+    int64_t min = *lo;
+    uint64_t range = static_cast<uint64_t>(int64_t(*hi) - min) + 1;
+    if (range > n) {
+        return false;
+    }
+    std::vector<uint32_t> count(range, 0);
+    for (size_t i = 0; i < n; ++i) {
+        ++count[v[i] - min];
+    }
+    int* out = v;
+    for (uint64_t d = 0; d < range; ++d) {
+        out = std::fill_n(out, count[d], static_cast<int>(min + static_cast<int64_t>(d)));
+    }
+    return true;
+}
+
+// Radix sort (LSD, 11-bit digits, signed keys via the flipped sign bit)
+void radix_sort(int* v, size_t n)
+{
+    constexpr int bits = 11, passes = 3;
+    constexpr uint32_t radix = 1u << bits, mask = radix - 1;
+    if (n < 2) {
+        return;
+    }
+    std::vector<size_t> count(passes * radix, 0);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t key = static_cast<uint32_t>(v[i]) ^ 0x80000000u;
+        for (int p = 0; p < passes; ++p) {
+            ++count[p * radix + ((key >> (p * bits)) & mask)];
+        }
+    }
+    std::vector<int> tmp(n);
+    int* src = v;
+    int* dst = tmp.data();
+    for (int p = 0; p < passes; ++p) {
+        size_t* c = &count[p * radix];
+        uint32_t first = ((static_cast<uint32_t>(src[0]) ^ 0x80000000u) >> (p * bits)) & mask;
+        if (c[first] == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (uint32_t d = 0; d < radix; ++d) {
+            size_t x = c[d];
+            c[d] = sum;
+            sum += x;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t key = static_cast<uint32_t>(src[i]) ^ 0x80000000u;
+            dst[c[(key >> (p * bits)) & mask]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != v) {
+        std::memcpy(v, src, n * sizeof(int));
+    }
 }
 
 void print(const mdp::vector<int>& v, std::ostream& os) {
@@ -195,13 +395,47 @@ void print(const mdp::vector<int>& v, std::ostream& os) {
     //}
 
 }
+// Number of values left in the stream, estimated from its size and the numbers per byte in the first
+// 64 KiB, plus 1/16 for the variations along the file: read() reserves once instead of growing from 1
+// (about 30 reallocations, with old and new blocks both alive at each one). 0 when the stream cannot
+// seek, as with a pipe.
+size_t estimate_count(std::istream& is)
+{
+    auto start = is.tellg();
+    if (start == std::streampos(-1) || !is.seekg(0, std::ios::end)) {
+        is.clear();
+        return 0;
+    }
+    size_t bytes = static_cast<size_t>(is.tellg() - start);
+    is.seekg(start);
+    std::vector<char> sample(std::min<size_t>(bytes, 1 << 16));
+    size_t got = static_cast<size_t>(is.rdbuf()->sgetn(sample.data(), sample.size()));
+    is.seekg(start);
+    if (got == 0) {
+        return 0;
+    }
+    size_t tokens = 0;
+    bool space = true;
+    for (size_t i = 0; i < got; ++i) {
+        bool s = sample[i] == ' ' || (sample[i] >= '\t' && sample[i] <= '\r');
+        tokens += space && !s;
+        space = s;
+    }
+    if (got == bytes) {
+        return tokens;
+    }
+    return static_cast<size_t>(static_cast<double>(tokens) * bytes / got * 1.0625) + 16;
+}
+
 // Returning void and working on a reference is unnatural coding
 void read(mdp::vector<int>& v, std::istream& is)
 {
     if (is.good())
     {
+        v.reserve(v.size() + estimate_count(is));
+        int_reader reader(is);
         int i;
-        while (is >> i) {
+        while (reader(i)) {
             v.push_back(i);
         }
     }
@@ -216,8 +450,10 @@ mdp::vector<int> read(std::istream& is)
     vector<int> v;
     if (is.good())
     {
+        v.reserve(v.size() + estimate_count(is));
+        int_reader reader(is);
         int i;
-        while (is >> i) {
+        while (reader(i)) {
             v.push_back(i);
         }
     }
@@ -225,6 +461,132 @@ mdp::vector<int> read(std::istream& is)
 }
 
 
+// ------------------------------ Record sort (--key N) ------------------------------
+// Every line of the input is a record, and its N-th field (from 1, fields are separated by whitespace)
+// is an integer key. The records never move during the sort: the keys are copied in a compact array,
+// with a second array holding the number of their line (structure of arrays, 8 bytes for each record
+// whatever its size), the two are radix sorted together, and at the end every line is written once, in
+// the final order, straight from the input buffer. Same algorithm as sorter_standard, with the record
+// arrays in mdp::vector.
+
+// radix_sort on keys, with index moved along. LSD passes are stable, so equal keys keep the input order.
+void radix_sort_index(int* keys, uint32_t* index, size_t n)
+{
+    constexpr int bits = 11, passes = 3;
+    constexpr uint32_t radix = 1u << bits, mask = radix - 1;
+    if (n < 2) {
+        return;
+    }
+    std::vector<size_t> count(passes * radix, 0);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t key = static_cast<uint32_t>(keys[i]) ^ 0x80000000u;
+        for (int p = 0; p < passes; ++p) {
+            ++count[p * radix + ((key >> (p * bits)) & mask)];
+        }
+    }
+    std::vector<int> keys_tmp(n);
+    std::vector<uint32_t> index_tmp(n);
+    int* key_src = keys;
+    int* key_dst = keys_tmp.data();
+    uint32_t* index_src = index;
+    uint32_t* index_dst = index_tmp.data();
+    for (int p = 0; p < passes; ++p) {
+        size_t* c = &count[p * radix];
+        uint32_t first = ((static_cast<uint32_t>(key_src[0]) ^ 0x80000000u) >> (p * bits)) & mask;
+        if (c[first] == n) {
+            continue;
+        }
+        size_t sum = 0;
+        for (uint32_t d = 0; d < radix; ++d) {
+            size_t x = c[d];
+            c[d] = sum;
+            sum += x;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t key = static_cast<uint32_t>(key_src[i]) ^ 0x80000000u;
+            size_t pos = c[(key >> (p * bits)) & mask]++;
+            key_dst[pos] = key_src[i];
+            index_dst[pos] = index_src[i];
+        }
+        std::swap(key_src, key_dst);
+        std::swap(index_src, index_dst);
+    }
+    if (key_src != keys) {
+        std::memcpy(keys, key_src, n * sizeof(int));
+        std::memcpy(index, index_src, n * sizeof(uint32_t));
+    }
+}
+
+bool sort_records(std::istream& is, std::ostream& os, size_t field)
+{
+    std::vector<char> text;
+    while (true) {
+        size_t n = text.size();
+        text.resize(n + (1 << 24));
+        is.read(text.data() + n, 1 << 24);
+        text.resize(n + is.gcount());
+        if (!is) {
+            break;
+        }
+    }
+    if (!text.empty() && text.back() != '\n') {
+        text.push_back('\n');
+    }
+
+    // Start of every non empty line, and its key
+    mdp::vector<size_t> start;
+    mdp::vector<int> keys;
+    for (size_t pos = 0, line = 1; pos < text.size(); ++line) {
+        size_t end = std::find(text.begin() + pos, text.end(), '\n') - text.begin();
+        const char* p = text.data() + pos;
+        const char* last = text.data() + end;
+        auto blank = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+        while (p < last && blank(*p)) {
+            ++p;
+        }
+        if (p < last) {
+            for (size_t f = 1; f < field && p < last; ++f) {
+                while (p < last && !blank(*p)) {
+                    ++p;
+                }
+                while (p < last && blank(*p)) {
+                    ++p;
+                }
+            }
+            if (p < last && *p == '+') {
+                ++p;
+            }
+            int key;
+            auto [ptr, ec] = std::from_chars(p, last, key);
+            if (ec != std::errc() || ptr == p || (ptr < last && !blank(*ptr))) {
+                std::cerr << "Line " << line << " has no integer in field " << field << "\n";
+                return false;
+            }
+            start.push_back(pos);
+            keys.push_back(key);
+        }
+        pos = end + 1;
+    }
+    if (start.size() > UINT32_MAX) {
+        std::cerr << "Too many records\n";
+        return false;
+    }
+
+    mdp::vector<uint32_t> index;
+    index.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        index.push_back(static_cast<uint32_t>(i));
+    }
+    radix_sort_index(keys.data(), index.data(), keys.size());
+
+    for (const auto& i : index) {
+        const char* line = text.data() + start[i];
+        const char* end = static_cast<const char*>(std::memchr(line, '\n', text.size() - start[i]));
+        os.write(line, end - line + 1);
+    }
+    return true;
+}
+
 int global_id = 0;
 struct widget
 {
@@ -245,23 +607,120 @@ struct widget
     {
         id_ = global_id++;
         x_ = other.x_;
+        if constexpr (mdp::instrumented) {
+            ++mdp::stats_of<widget>().copies;
+        }
     }
     widget& operator=(const widget& other)
     {
         x_ = other.x_;
+        if constexpr (mdp::instrumented) {
+            ++mdp::stats_of<widget>().copies;
+        }
         return *this;
     }
     ~widget()
     {
         //global_id--;
-        std::cout << "Destroying widget" << std::endl;
+        // Was: std::cout << "Destroying widget" << std::endl; (see MDP_INSTRUMENT)
+        if constexpr (mdp::instrumented) {
+            ++mdp::stats_of<widget>().destroys;
+        }
     }
 };
 
+// Sorted values to "SVBDELTA": zigzag deltas as Stream VByte, lengths in separate control bytes
+void write_svb(std::ostream& os, const int* v, size_t n)
+{
+    std::vector<uint8_t> control((n + 3) / 4, 0);
+    std::vector<uint8_t> data;
+    data.reserve(n * 4);
+    uint32_t prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t delta = static_cast<uint32_t>(v[i]) - prev;
+        prev = static_cast<uint32_t>(v[i]);
+        uint32_t zz = (delta << 1) ^ (0u - (delta >> 31));
+        uint32_t len = 1 + (zz > 0xff) + (zz > 0xffff) + (zz > 0xffffff);
+        control[i / 4] |= static_cast<uint8_t>((len - 1) << (2 * (i % 4)));
+        for (uint32_t b = 0; b < len; ++b) {
+            data.push_back(static_cast<uint8_t>(zz >> (8 * b)));
+        }
+    }
+    os.write("SVBDELTA", 8);
+    for (int i = 0; i < 32; i += 8) {
+        os.put(static_cast<char>(n >> i));
+    }
+    os.write(reinterpret_cast<const char*>(control.data()), control.size());
+    os.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// sorter_optimised --bench: push-heavy ingestion, mdp::vector against std::vector, with and without
+// reserve, for ints (realloc growth) and for strings (element by element moves)
+template<typename V, typename F>
+double time_push(size_t n, bool reserve, F make)
+{
+    auto start = std::chrono::steady_clock::now();
+    {
+        V v;
+        if (reserve) {
+            v.reserve(n);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            v.push_back(make(i));
+        }
+        if (v.size() != n) {
+            std::cerr << "Wrong size\n";
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void bench()
+{
+    const size_t n = 50000000;
+    auto make_int = [](size_t i) { return static_cast<int>(i * 2654435761u); };
+    auto make_string = [](size_t i) { return std::string(32, static_cast<char>('a' + i % 26)); };
+    for (bool reserve : { false, true }) {
+        std::cout << (reserve ? "with reserve\n" : "without reserve\n");
+        std::cout << "  " << n << " int,        std::vector " << time_push<std::vector<int>>(n, reserve, make_int) << " s\n";
+        std::cout << "  " << n << " int,        mdp::vector " << time_push<mdp::vector<int>>(n, reserve, make_int) << " s\n";
+        std::cout << "  " << n << " int,  mdp::vector (1.5) " << time_push<mdp::vector<int, std::ratio<3, 2>>>(n, reserve, make_int) << " s\n";
+        std::cout << "  " << n / 10 << " string,      std::vector " << time_push<std::vector<std::string>>(n / 10, reserve, make_string) << " s\n";
+        std::cout << "  " << n / 10 << " string,      mdp::vector " << time_push<mdp::vector<std::string>>(n / 10, reserve, make_string) << " s\n";
+    }
+}
+
 int main(int argc, char* argv[]) {
     {
-        if (argc != 3) {
-            std::cerr << "Usage: sort_int <filein.txt> <fileout.txt>\n";
+        if (argc == 2 && std::string(argv[1]) == "--bench") {
+            bench();
+            return 0;
+        }
+        bool binary = false, radix = false, usage = argc < 3;
+        size_t key_field = 0;
+        for (int i = 3; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "--binary") {
+                binary = true;
+            }
+            else if (opt == "--radix") {
+                radix = true;
+            }
+            else if (opt == "--key" && i + 1 < argc) {
+                std::string_view arg = argv[++i];
+                if (std::from_chars(arg.data(), arg.data() + arg.size(), key_field).ec != std::errc() || key_field == 0) {
+                    usage = true;
+                }
+            }
+            else {
+                usage = true;
+            }
+        }
+        if (usage) {
+            std::cerr << "Usage: sort_int <filein.txt> <fileout.txt> [--binary] [--radix]\n";
+            std::cerr << "       sort_int <filein.txt> <fileout.txt> --key <N>\n";
+            std::cerr << "       sort_int --bench\n";
             return 1;
         }
 
@@ -271,22 +730,47 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
-        std::ofstream fileout(argv[2]);
+        std::ofstream fileout(argv[2], binary ? std::ios::binary : std::ios::out);
         if (!fileout.is_open()) {
             perror("Error opening output file");
             filein.close();
             return 1;
         }
 
+        if (key_field > 0) {
+            if (binary) {
+                std::cerr << "--key writes text only\n";
+                return 1;
+            }
+            return sort_records(filein, fileout, key_field) ? 0 : 1;
+        }
+
         mdp::vector<int> numbers = read(filein);
 
-        std::qsort(numbers.data_, numbers.size(), sizeof(int), compare_ints);
+        const char* strategy;
+        if (counting_sort(numbers.data(), numbers.size())) {
+            strategy = "counting sort";
+        }
+        else if (radix) {
+            radix_sort(numbers.data(), numbers.size());
+            strategy = "radix sort";
+        }
+        else {
+            std::qsort(numbers.data(), numbers.size(), sizeof(int), compare_ints);
+            strategy = "qsort";
+        }
+        std::cerr << "Sorted " << numbers.size() << " values with " << strategy << "\n";
         // If using std::vector
         //std::qsort(&numbers[0], numbers.size(), sizeof(int), compare_ints);
         // or
         //std::qsort(numbers.data(), numbers.size(), sizeof(int), compare_ints);
 
-        print(numbers, fileout);
+        if (binary) {
+            write_svb(fileout, numbers.data(), numbers.size());
+        }
+        else {
+            print(numbers, fileout);
+        }
 
         // Lesson purpose
         int x = numbers[0];